@@ -1,41 +1,495 @@
 #include <cstdint>
 #include <cstring>
+#include <cstdlib>
+#include <cmath>
 #include <cassert>
+#include <cerrno>
 #include <vector>
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <iterator>
 #include <string>
 #include <stdexcept>
 #include <limits>
 #include <cstdio>    // std::remove
+#include <cstdarg>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <type_traits>
 #include <sys/stat.h>
 #ifdef _WIN32
   #include <direct.h>
+#else
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <signal.h>
+  #include <sys/mman.h>
+  #include <sys/wait.h>
+  #include <sys/resource.h>
+#endif
+#ifdef __linux__
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// Memory accounting: pixel buffers allocate through Tracked, which keeps live and
+// peak byte counts; Stage scopes record the peak reached inside them
+// -----------------------------------------------------------------------------
+namespace Memory {
+    static std::atomic<int64_t> liveBytes{0};
+    static std::atomic<int64_t> peakBytes{0};
+    static uint64_t budget = 0;          // --mem-budget: schedulers defer work beyond this (0 = none)
+    static bool     report = false;      // --mem-report: keep per-stage results
+
+    inline int64_t live(){ return liveBytes.load(std::memory_order_relaxed); }
+    inline int64_t peak(){ return peakBytes.load(std::memory_order_relaxed); }
+
+    inline void raisePeak(int64_t v){
+        int64_t p = peakBytes.load(std::memory_order_relaxed);
+        while(v > p && !peakBytes.compare_exchange_weak(p, v, std::memory_order_relaxed)) {}
+    }
+
+    template<class T>
+    struct Tracked {
+        using value_type = T;
+        Tracked() = default;
+        template<class U> Tracked(const Tracked<U>&) {}
+
+        T* allocate(size_t n){
+            T* p = std::allocator<T>().allocate(n);
+            raisePeak(liveBytes.fetch_add(int64_t(n * sizeof(T)), std::memory_order_relaxed) + int64_t(n * sizeof(T)));
+            return p;
+        }
+        void deallocate(T* p, size_t n){
+            liveBytes.fetch_sub(int64_t(n * sizeof(T)), std::memory_order_relaxed);
+            std::allocator<T>().deallocate(p, n);
+        }
+        template<class U> bool operator==(const Tracked<U>&) const { return true; }
+        template<class U> bool operator!=(const Tracked<U>&) const { return false; }
+    };
+
+    struct StageResult {
+        std::string name;
+        int64_t     peak     = 0;    // highest live pixel bytes while the stage ran
+        int64_t     retained = 0;    // live bytes it left behind
+    };
+    static std::vector<StageResult> stages;
+    static std::mutex               stageLock;
+    static std::atomic<int64_t>     workerPeak{0};   // largest item peak reported by worker processes
+
+    inline void record(const StageResult& r){
+        if(!report) return;
+        std::lock_guard<std::mutex> lk(stageLock);
+        stages.push_back(r);
+    }
+
+    // peak of a scope: the global peak restarts at the current live count and is folded
+    // back into the enclosing peak on exit. Concurrent stages see each other's bytes.
+    struct Stage {
+        std::string name;
+        int64_t     outerPeak, startLive;
+
+        explicit Stage(std::string n) : name(std::move(n)), outerPeak(peak()), startLive(live()) {
+            peakBytes.store(startLive, std::memory_order_relaxed);
+        }
+        int64_t peakSoFar() const { return peak(); }
+        ~Stage(){
+            record(StageResult{name, peak(), live() - startLive});
+            raisePeak(outerPeak);
+        }
+    };
+
+    // kernel high-water mark in bytes (0 where unsupported): this process, or with
+    // children = true the largest of its reaped child processes (the --workers)
+    inline uint64_t peakRss(bool children = false){
+#ifdef _WIN32
+        (void)children;
+        return 0;
+#else
+        rusage ru{};
+        if(getrusage(children ? RUSAGE_CHILDREN : RUSAGE_SELF, &ru) != 0) return 0;
+  #ifdef __APPLE__
+        return static_cast<uint64_t>(ru.ru_maxrss);
+  #else
+        return static_cast<uint64_t>(ru.ru_maxrss) * 1024;
+  #endif
 #endif
+    }
+
+    inline double mb(int64_t b){ return b / (1024.0 * 1024.0); }
+
+    // --mem-report: stage table and run totals, printed when the command finishes
+    struct Scope {
+        bool on;
+        explicit Scope(bool o) : on(o) { report = o; }
+        ~Scope(){
+            if(!on) return;
+            std::lock_guard<std::mutex> lk(stageLock);
+            std::fprintf(stderr, "memory: %-24s %12s %12s\n", "stage", "peak MB", "retained MB");
+            for(const StageResult& s : stages)
+                std::fprintf(stderr, "memory: %-24s %12.2f %12.2f\n", s.name.c_str(), mb(s.peak), mb(s.retained));
+            // worker items are stage rows relayed by the parent; the run line keeps this
+            // process apart from the largest worker, since their peaks don't add up
+            std::fprintf(stderr, "memory: run peak %.2f MB of pixels, peak RSS %.2f MB%s\n", mb(peak()),
+                         mb(static_cast<int64_t>(peakRss())),
+                         budget ? (", budget " + std::to_string(budget / (1024 * 1024)) + " MB").c_str() : "");
+            if(const uint64_t childRss = peakRss(true))
+                std::fprintf(stderr, "memory: largest worker: peak %.2f MB of pixels per item, peak RSS %.2f MB\n",
+                             mb(workerPeak.load()), mb(static_cast<int64_t>(childRss)));
+        }
+    };
+}
 
 // -----------------------------------------------------------------------------
-// Image container
+// Image containers
 // -----------------------------------------------------------------------------
+// rectangle in pixel coordinates, bottom-left origin like Image::px
+struct Rect {
+    int x = 0, y = 0, w = 0, h = 0;
+};
+
+// strided, non-owning window into BGR pixels (T = uint8_t or const uint8_t)
+template<class T>
+struct PixelView {
+    T*        data   = nullptr;  // first pixel of the bottom row
+    int       width  = 0;
+    int       height = 0;
+    ptrdiff_t stride = 0;        // bytes from one row to the row above (negative for top-left storage)
+
+    T* row(int y) const { return data + y * stride; }
+    T* px(int x, int y) const {
+        assert(x >= 0 && x < width && y >= 0 && y < height);
+        return row(y) + x * 3;
+    }
+
+    // mutable views convert to read-only ones
+    template<class U = T, class = typename std::enable_if<!std::is_const<U>::value>::type>
+    operator PixelView<const U>() const { return PixelView<const U>{data, width, height, stride}; }
+};
+using ImageView      = PixelView<uint8_t>;
+using ConstImageView = PixelView<const uint8_t>;
+
 struct Image {
     uint16_t width  = 0;
     uint16_t height = 0;
-    std::vector<uint8_t> pixels;        // B, G, R
+    std::vector<uint8_t, Memory::Tracked<uint8_t>> pixels;   // B, G, R
+    bool     topLeft = false;           // rows stored top-down (file order) instead of bottom-up
     static constexpr size_t PIXEL_SIZE = 3;
 
-    // bottom-left origin in memory
+    // coordinates are always bottom-left origin; memRow maps them to storage
+    size_t memRow(int y) const{ return topLeft ? height - 1 - y : y; }
+
     uint8_t* px(int x, int y){
         assert(x >= 0 && x < width && y >= 0 && y < height);
-        return pixels.data() + ((y * width + x) * PIXEL_SIZE);
+        return pixels.data() + ((memRow(y) * width + x) * PIXEL_SIZE);
     }
     const uint8_t* px(int x, int y) const{
         assert(x >= 0 && x < width && y >= 0 && y < height);
-        return pixels.data() + ((y * width + x) * PIXEL_SIZE);
+        return pixels.data() + ((memRow(y) * width + x) * PIXEL_SIZE);
+    }
+
+    // zero-copy views; the region must lie inside the image
+    ImageView view(const Rect& r){
+        checkRect(r);
+        if(r.w == 0 || r.h == 0) return ImageView{pixels.data(), r.w, r.h, 0};
+        return ImageView{px(r.x, r.y), r.w, r.h, rowStride()};
+    }
+    ConstImageView view(const Rect& r) const{
+        checkRect(r);
+        if(r.w == 0 || r.h == 0) return ConstImageView{pixels.data(), r.w, r.h, 0};
+        return ConstImageView{px(r.x, r.y), r.w, r.h, rowStride()};
+    }
+    ptrdiff_t rowStride() const{
+        ptrdiff_t b = width * PIXEL_SIZE;
+        return topLeft ? -b : b;
+    }
+
+    // reverse the row order in place if the storage origin differs
+    void setOrigin(bool wantTopLeft){
+        if(wantTopLeft == topLeft) return;
+        const size_t rowBytes = width * PIXEL_SIZE;
+        for(int y = 0; y < height / 2; ++y)
+            std::swap_ranges(pixels.begin() + y * rowBytes, pixels.begin() + (y + 1) * rowBytes,
+                             pixels.begin() + (height - 1 - y) * rowBytes);
+        topLeft = wantTopLeft;
+    }
+    ImageView      view()      { return view(Rect{0, 0, width, height}); }
+    ConstImageView view() const{ return view(Rect{0, 0, width, height}); }
+
+    // compares against the room left so x + w never overflows int
+    void checkRect(const Rect& r) const{
+        if(r.x < 0 || r.y < 0 || r.w < 0 || r.h < 0 || r.x > width || r.y > height || r.w > width - r.x || r.h > height - r.y)
+            throw std::runtime_error("region " + std::to_string(r.w) + "x" + std::to_string(r.h) + "+" +
+                                     std::to_string(r.x) + "+" + std::to_string(r.y) + " outside " +
+                                     std::to_string(width) + "x" + std::to_string(height) + " image");
+    }
+};
+
+// 16 bits per channel working format for long chains (same layout as Image)
+struct Image16 {
+    uint16_t width  = 0;
+    uint16_t height = 0;
+    std::vector<uint16_t, Memory::Tracked<uint16_t>> pixels; // B, G, R
+    bool     topLeft = false;
+    static constexpr size_t PIXEL_SIZE = 3;
+
+    size_t memRow(int y) const{ return topLeft ? height - 1 - y : y; }
+
+    uint16_t* px(int x, int y){
+        assert(x >= 0 && x < width && y >= 0 && y < height);
+        return pixels.data() + ((memRow(y) * width + x) * PIXEL_SIZE);
+    }
+    const uint16_t* px(int x, int y) const{
+        assert(x >= 0 && x < width && y >= 0 && y < height);
+        return pixels.data() + ((memRow(y) * width + x) * PIXEL_SIZE);
     }
 };
 
 namespace ColorMath {
     inline uint8_t clampByte(int v){ return v < 0 ? 0 : (v > 255 ? 255 : v); }
+    // BT.601 luma, 8-bit fixed point
+    inline uint8_t luma(int b, int g, int r){ return static_cast<uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8); }
+}
+
+// -----------------------------------------------------------------------------
+// Threading helpers
+// -----------------------------------------------------------------------------
+namespace Parallel {
+    static unsigned maxThreads = 0;     // 0 = hardware concurrency
+
+    inline unsigned threadCount(size_t items){
+        unsigned t = maxThreads ? maxThreads : std::thread::hardware_concurrency();
+        if(t == 0) t = 1;
+        return static_cast<unsigned>(std::min<size_t>(t, std::max<size_t>(items, 1)));
+    }
+
+    // split [0, n) into threadCount(n) contiguous ranges; fn(slot, begin, end) runs once per range
+    template<class F>
+    void forSlots(size_t n, F fn){
+        unsigned t = threadCount(n);
+        size_t step = (n + t - 1) / t;
+        if(t <= 1){ fn(0u, size_t(0), n); return; }
+        std::vector<std::thread> pool;
+        pool.reserve(t - 1);
+        for(unsigned i = 1; i < t; ++i){
+            size_t b = std::min(n, i * step), e = std::min(n, b + step);
+            pool.emplace_back(fn, i, b, e);
+        }
+        fn(0u, size_t(0), std::min(n, step));
+        for(auto& th : pool) th.join();
+    }
+
+    // fn(begin, end) per range
+    template<class F>
+    void forRange(size_t n, F fn){
+        forSlots(n, [&](unsigned, size_t b, size_t e){ if(b < e || n == 0) fn(b, e); });
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Quantization of 16-bit images to bytes, with optional dithering
+// -----------------------------------------------------------------------------
+namespace Dither {
+    enum Mode { NONE, BAYER, BLUE_NOISE, FLOYD_STEINBERG };
+
+    // nearest byte: v * 255 / 65535, rounded
+    inline uint8_t toByte(uint32_t v){ return static_cast<uint8_t>((v * 255 + 32767) / 65535); }
+
+    // threshold in [0, 65535) added before truncating, so a flat input averages to its exact value
+    inline uint8_t thresholdByte(uint32_t v, uint32_t t){
+        uint32_t q = (v * 255 + t) / 65535;
+        return static_cast<uint8_t>(q > 255 ? 255 : q);
+    }
+
+    static const uint8_t BAYER8[8][8] = {
+        { 0,32, 8,40, 2,34,10,42}, {48,16,56,24,50,18,58,26},
+        {12,44, 4,36,14,46, 6,38}, {60,28,52,20,62,30,54,22},
+        { 3,35,11,43, 1,33, 9,41}, {51,19,59,27,49,17,57,25},
+        {15,47, 7,39,13,45, 5,37}, {63,31,55,23,61,29,53,21},
+    };
+
+    // 64x64 blue-noise rank map built once by void-and-cluster (Ulichney) on a torus
+    constexpr int BN_SIZE = 64;
+    static const std::vector<uint16_t>& blueNoise(){
+        static const std::vector<uint16_t> ranks = []{
+            constexpr int N = BN_SIZE * BN_SIZE, R = 6;
+            const double sigma2 = 2.0 * 1.5 * 1.5;
+            std::vector<double> energy(N, 0.0);
+            std::vector<uint8_t> on(N, 0);
+            std::vector<uint16_t> rank(N, 0);
+            auto splat = [&](int idx, double sign){
+                int px = idx % BN_SIZE, py = idx / BN_SIZE;
+                for(int dy = -R; dy <= R; ++dy)
+                    for(int dx = -R; dx <= R; ++dx){
+                        int x = (px + dx + BN_SIZE) % BN_SIZE, y = (py + dy + BN_SIZE) % BN_SIZE;
+                        energy[y * BN_SIZE + x] += sign * std::exp(-(dx * dx + dy * dy) / sigma2);
+                    }
+            };
+            auto extreme = [&](uint8_t state, bool wantMax){
+                int best = -1;
+                for(int i = 0; i < N; ++i)
+                    if(on[i] == state && (best < 0 || (wantMax ? energy[i] > energy[best] : energy[i] < energy[best]))) best = i;
+                return best;
+            };
+            // initial pattern: ~10% points from a fixed LCG, then swap clusters into voids until stable
+            uint32_t seed = 12345;
+            int ones = 0;
+            for(int i = 0; i < N; ++i){
+                seed = seed * 1664525u + 1013904223u;
+                if((seed >> 24) < 26){ on[i] = 1; splat(i, 1); ++ones; }
+            }
+            for(int iter = 0; iter < N; ++iter){
+                int c = extreme(1, true);
+                on[c] = 0; splat(c, -1);
+                int v = extreme(0, false);
+                on[v] = 1; splat(v, 1);
+                if(v == c) break;
+            }
+            std::vector<uint8_t> initial = on;
+            std::vector<double> initialEnergy = energy;
+            for(int r = ones - 1; r >= 0; --r){            // remove tightest clusters
+                int c = extreme(1, true);
+                on[c] = 0; splat(c, -1); rank[c] = r;
+            }
+            on = initial; energy = initialEnergy;
+            for(int r = ones; r < N; ++r){                // fill largest voids
+                int v = extreme(0, false);
+                on[v] = 1; splat(v, 1); rank[v] = r;
+            }
+            return rank;
+        }();
+        return ranks;
+    }
+
+    // Floyd-Steinberg, row-parallel: row y may quantize pixel x once row y-1 has passed x+1,
+    // so T threads work on T consecutive rows as a diagonal wavefront
+    static void floydSteinberg(const Image16& src, Image& out){
+        const int w = src.width, h = src.height, rowVals = w * 3;
+        constexpr int BLOCK = 64;
+        const unsigned T = Parallel::threadCount(h);
+        const int ringRows = static_cast<int>(T) + 2;
+        std::vector<int32_t> err(size_t(ringRows) * (rowVals + 6), 0);  // incoming error per row, 1 px pad each side
+        std::unique_ptr<std::atomic<int>[]> progress(new std::atomic<int>[h]);
+        for(int y = 0; y < h; ++y) progress[y].store(0, std::memory_order_relaxed);
+        auto errRow = [&](int y){ return err.data() + size_t(y % ringRows) * (rowVals + 6) + 3; };
+
+        auto worker = [&](unsigned t){
+            for(int y = static_cast<int>(t); y < h; y += static_cast<int>(T)){
+                int32_t* cur = errRow(y);
+                int32_t* nxt = errRow(y + 1);
+                // this slot was last used by row y+1-ringRows, which this thread's previous row
+                // waited to finish; clearing it here is the only reset (row 0's input starts zeroed)
+                std::fill(nxt - 3, nxt + rowVals + 3, 0);
+                const uint16_t* s = src.pixels.data() + size_t(y) * rowVals;
+                uint8_t* d = out.pixels.data() + size_t(y) * rowVals;
+                for(int x0 = 0; x0 < w; x0 += BLOCK){
+                    const int x1 = std::min(w, x0 + BLOCK);
+                    if(y > 0){
+                        const int need = std::min(w, x1 + 1);
+                        while(progress[y - 1].load(std::memory_order_acquire) < need) std::this_thread::yield();
+                    }
+                    for(int x = x0; x < x1; ++x)
+                        for(int c = 0; c < 3; ++c){
+                            const int i = x * 3 + c;
+                            int v = s[i] + (cur[i] + (cur[i] >= 0 ? 8 : -8)) / 16;
+                            v = v < 0 ? 0 : (v > 65535 ? 65535 : v);
+                            uint8_t q = toByte(v);
+                            d[i] = q;
+                            int e = v - q * 257;
+                            cur[i + 3]  += e * 7;
+                            nxt[i - 3]  += e * 3;
+                            nxt[i]      += e * 5;
+                            nxt[i + 3]  += e;
+                        }
+                    progress[y].store(x1, std::memory_order_release);
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for(unsigned t = 1; t < T; ++t) pool.emplace_back(worker, t);
+        worker(0);
+        for(auto& th : pool) th.join();
+    }
+
+    Image quantize(const Image16& src, Mode mode){
+        Image out;
+        out.width = src.width; out.height = src.height; out.topLeft = src.topLeft;
+        out.pixels.resize(src.pixels.size());
+        if(mode == FLOYD_STEINBERG){ floydSteinberg(src, out); return out; }
+        const std::vector<uint16_t>* bn = (mode == BLUE_NOISE) ? &blueNoise() : nullptr;
+        const size_t rowVals = src.width * Image16::PIXEL_SIZE;
+        Parallel::forRange(src.height, [&](size_t y0, size_t y1){
+            for(size_t y = y0; y < y1; ++y){
+                const uint16_t* s = src.pixels.data() + y * rowVals;
+                uint8_t* d = out.pixels.data() + y * rowVals;
+                if(mode == NONE){
+                    for(size_t i = 0; i < rowVals; ++i) d[i] = toByte(s[i]);
+                    continue;
+                }
+                for(int x = 0; x < src.width; ++x){
+                    uint32_t t = (mode == BAYER)
+                        ? (2u * BAYER8[y & 7][x & 7] + 1) * 65535u / 128u
+                        : (2u * (*bn)[(y % BN_SIZE) * BN_SIZE + (x % BN_SIZE)] + 1) * 65535u / (2u * BN_SIZE * BN_SIZE);
+                    for(int c = 0; c < 3; ++c) d[x * 3 + c] = thresholdByte(s[x * 3 + c], t);
+                }
+            }
+        });
+        return out;
+    }
+
+    inline Mode parse(const std::string& name){
+        if(name == "none")      return NONE;
+        if(name == "bayer")     return BAYER;
+        if(name == "bluenoise") return BLUE_NOISE;
+        if(name == "fs")        return FLOYD_STEINBERG;
+        throw std::runtime_error("unknown dither: " + name + " (none|bayer|bluenoise|fs)");
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Input validation: decoders check headers against these limits and the real
+// file size before allocating, so the pixel loops can stay check-free
+// -----------------------------------------------------------------------------
+namespace Validate {
+    struct Limits {
+        uint32_t maxDim    = 65535;           // per side (Image stores 16-bit sizes)
+        uint64_t maxPixels = 1ull << 28;      // 256 Mpx, ~768 MB of BGR
+    };
+    static Limits limits;
+
+    inline void dims(uint64_t w, uint64_t h, const std::string& what){
+        if(w > limits.maxDim || h > limits.maxDim)
+            throw std::runtime_error(what + ": " + std::to_string(w) + "x" + std::to_string(h) +
+                                     " exceeds the " + std::to_string(limits.maxDim) + " pixel side limit");
+        if(w * h > limits.maxPixels)
+            throw std::runtime_error(what + ": " + std::to_string(w * h) + " pixels exceeds the " +
+                                     std::to_string(limits.maxPixels) + " pixel limit");
+    }
+
+    // the header promises `needed` bytes; fail before allocating if the file is shorter
+    inline void payload(uint64_t available, uint64_t needed, const std::string& what){
+        if(available < needed)
+            throw std::runtime_error(what + ": truncated (" + std::to_string(available) + " of " +
+                                     std::to_string(needed) + " bytes)");
+    }
+
+    inline uint64_t fileSize(std::istream& in){
+        auto here = in.tellg();
+        in.seekg(0, std::ios::end);
+        auto end = in.tellg();
+        in.seekg(here);
+        return end < 0 ? 0 : static_cast<uint64_t>(end);
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -61,34 +515,48 @@ namespace TGA {
 
     constexpr uint8_t ORIGIN_TOP_LEFT = 0x20;
 
-    Image load(const std::string& path){
+    // keepOrigin: store rows in file order (no flip); otherwise always bottom-left in memory
+    Image load(const std::string& path, bool keepOrigin = true){
         std::ifstream file(path, std::ios::binary);
         if(!file) throw std::runtime_error("Can't open TGA: " + path);
 
+        const uint64_t fileBytes = Validate::fileSize(file);
+        Validate::payload(fileBytes, sizeof(Header), path);
         Header hdr{};
         file.read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+        const bool gray = hdr.dataTypeCode == 3;
         if(hdr.colorMapType != 0) throw std::runtime_error(path + ": only unmapped images supported");
-        if(hdr.dataTypeCode != 2) throw std::runtime_error(path + ": need uncompressed RGB (2)");
-        if(hdr.bitsPerPixel != 24) throw std::runtime_error(path + ": need 24-bit RGB");
+        if(hdr.dataTypeCode != 2 && !gray) throw std::runtime_error(path + ": need uncompressed RGB (2) or gray (3)");
+        if(hdr.bitsPerPixel != (gray ? 8 : 24)) throw std::runtime_error(path + (gray ? ": need 8-bit gray" : ": need 24-bit RGB"));
+        Validate::dims(hdr.width, hdr.height, path);
+        Validate::payload(fileBytes, sizeof(Header) + hdr.idLength +
+                          uint64_t(hdr.width) * hdr.height * (hdr.bitsPerPixel / 8), path);
         if(hdr.idLength) file.seekg(hdr.idLength, std::ios::cur);
 
         Image img;
         img.width  = hdr.width;
         img.height = hdr.height;
-        img.pixels.resize(img.width * img.height * Image::PIXEL_SIZE);
-        file.read(reinterpret_cast<char*>(img.pixels.data()), img.pixels.size());
-        if(!file) throw std::runtime_error(path + ": truncated pixel data");
+        img.pixels.resize(size_t(img.width) * img.height * Image::PIXEL_SIZE);
 
-        // convert top-left files to bottom-left memory
-        if(hdr.imageDescriptor & ORIGIN_TOP_LEFT){
-            const size_t rowBytes = img.width * Image::PIXEL_SIZE;
-            std::vector<uint8_t> tmp(img.pixels.size());
-            for(int y = 0; y < img.height; ++y){
-                std::memcpy(tmp.data() + y * rowBytes,
-                            img.pixels.data() + (img.height - 1 - y) * rowBytes,
-                            rowBytes);
-            }
-            img.pixels.swap(tmp);
+        const bool   fileTopLeft = hdr.imageDescriptor & ORIGIN_TOP_LEFT;
+        const bool   flip        = fileTopLeft && !keepOrigin;
+        const size_t rowBytes    = img.width * Image::PIXEL_SIZE;
+        const size_t fileRow     = gray ? img.width : rowBytes;
+        img.topLeft = fileTopLeft && keepOrigin;
+        if(!flip && !gray){
+            file.read(reinterpret_cast<char*>(img.pixels.data()), img.pixels.size());
+            if(!file) throw std::runtime_error(path + ": truncated pixel data");
+            return img;
+        }
+
+        // read each file row straight into its final memory row (no second buffer);
+        // gray rows land at the start of their row and expand back to front in place
+        for(int i = 0; i < img.height; ++i){
+            uint8_t* d = img.pixels.data() + (flip ? img.height - 1 - i : i) * rowBytes;
+            file.read(reinterpret_cast<char*>(d), fileRow);
+            if(!file) throw std::runtime_error(path + ": truncated pixel data");
+            if(gray)
+                for(size_t x = img.width; x-- > 0; ) d[x*3] = d[x*3+1] = d[x*3+2] = d[x];
         }
         return img;
     }
@@ -102,7 +570,7 @@ namespace TGA {
         hdr.width           = img.width;
         hdr.height          = img.height;
         hdr.bitsPerPixel    = 24;
-        hdr.imageDescriptor = 0x00;   // bottom-left
+        hdr.imageDescriptor = img.topLeft ? ORIGIN_TOP_LEFT : 0x00;   // rows go out in storage order
 
         file.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
 
@@ -113,150 +581,2587 @@ namespace TGA {
         }
         if(!file) throw std::runtime_error("Write failed: " + path);
     }
+
+    // 8-bit grayscale (type 3) holding the luma of each pixel
+    void saveGray(const Image& img, const std::string& path){
+        std::ofstream file(path, std::ios::binary);
+        if(!file) throw std::runtime_error("Can't write TGA: " + path);
+
+        Header hdr{};
+        hdr.dataTypeCode    = 3;
+        hdr.width           = img.width;
+        hdr.height          = img.height;
+        hdr.bitsPerPixel    = 8;
+        hdr.imageDescriptor = img.topLeft ? ORIGIN_TOP_LEFT : 0x00;
+
+        file.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+
+        std::vector<uint8_t> row(img.width);
+        const size_t rowBytes = img.width * Image::PIXEL_SIZE;
+        for(int y = 0; y < img.height; ++y){
+            const uint8_t* s = img.pixels.data() + y * rowBytes;
+            for(int x = 0; x < img.width; ++x, s += Image::PIXEL_SIZE) row[x] = ColorMath::luma(s[0], s[1], s[2]);
+            file.write(reinterpret_cast<const char*>(row.data()), row.size());
+        }
+        if(!file) throw std::runtime_error("Write failed: " + path);
+    }
+
+    // 16-bit images are rounded (or dithered) to bytes at write time
+    void save(const Image16& img, const std::string& path, Dither::Mode dither = Dither::NONE){
+        save(Dither::quantize(img, dither), path);
+    }
 }
 
 // -----------------------------------------------------------------------------
-// Blend ops
+// QOI I/O (lossless, "Quite OK Image" format, RGB only)
 // -----------------------------------------------------------------------------
-namespace Blend {
-    enum Mode { ADD, SUBTRACT, MULTIPLY, SCREEN, OVERLAY };
+namespace QOI {
+    constexpr uint8_t OP_INDEX = 0x00;
+    constexpr uint8_t OP_DIFF  = 0x40;
+    constexpr uint8_t OP_LUMA  = 0x80;
+    constexpr uint8_t OP_RUN   = 0xc0;
+    constexpr uint8_t OP_RGB   = 0xfe;
+    constexpr uint8_t OP_RGBA  = 0xff;
+    constexpr uint8_t MASK_2   = 0xc0;
+    constexpr size_t  HEADER_SIZE = 14;
+    constexpr uint8_t END_MARKER[8] = {0,0,0,0,0,0,0,1};
 
-    static uint8_t multiply_lut[256][256];
-    static uint8_t screen_lut[256][256];
-    static bool    luts_initialized = false;
+    struct Px { uint8_t r, g, b, a; };
+    inline int hash(const Px& p){ return (p.r*3 + p.g*5 + p.b*7 + p.a*11) & 63; }
+    inline bool same(const Px& p, const Px& q){ return p.r==q.r && p.g==q.g && p.b==q.b && p.a==q.a; }
 
-    inline uint8_t mul255_round(int a, int b){ return (a*b + 127) / 255; }
-    inline uint8_t scr255_round(int a, int b){ return 255 - ((255 - a) * (255 - b) + 127) / 255; }
+    inline void put32(std::vector<uint8_t>& o, uint32_t v){
+        o.push_back(v >> 24); o.push_back(v >> 16); o.push_back(v >> 8); o.push_back(v);
+    }
+    inline uint32_t get32(const uint8_t* p){
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
 
-    void init_luts(){
-        if(luts_initialized) return;
-        for(int a=0;a<256;++a)
-            for(int b=0;b<256;++b){
-                multiply_lut[a][b] = mul255_round(a,b);
-                screen_lut[a][b]   = scr255_round(a,b);
+    // QOI is top-left row-major RGB; memory is BGR in either row order
+    std::vector<uint8_t> encode(const Image& img){
+        std::vector<uint8_t> out;
+        out.reserve(HEADER_SIZE + img.pixels.size() + img.pixels.size() / 3 + sizeof(END_MARKER));
+        out.insert(out.end(), {'q','o','i','f'});
+        put32(out, img.width);
+        put32(out, img.height);
+        out.push_back(3);   // channels
+        out.push_back(0);   // sRGB with linear alpha
+
+        Px index[64] = {};
+        Px prev{0,0,0,255};
+        int run = 0;
+        const size_t rowBytes = img.width * Image::PIXEL_SIZE;
+        for(int y = img.height - 1; y >= 0; --y){
+            const uint8_t* s = img.pixels.data() + img.memRow(y) * rowBytes;
+            for(int x = 0; x < img.width; ++x, s += Image::PIXEL_SIZE){
+                Px p{s[2], s[1], s[0], 255};
+                if(same(p, prev)){
+                    if(++run == 62){ out.push_back(OP_RUN | (run - 1)); run = 0; }
+                    continue;
+                }
+                if(run){ out.push_back(OP_RUN | (run - 1)); run = 0; }
+
+                int h = hash(p);
+                if(same(index[h], p)){
+                    out.push_back(OP_INDEX | h);
+                }else{
+                    index[h] = p;
+                    int8_t dr = p.r - prev.r, dg = p.g - prev.g, db = p.b - prev.b;
+                    int8_t dr_dg = dr - dg, db_dg = db - dg;
+                    if(dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2){
+                        out.push_back(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    }else if(dg > -33 && dg < 32 && dr_dg > -9 && dr_dg < 8 && db_dg > -9 && db_dg < 8){
+                        out.push_back(OP_LUMA | (dg + 32));
+                        out.push_back((dr_dg + 8) << 4 | (db_dg + 8));
+                    }else{
+                        out.push_back(OP_RGB); out.push_back(p.r); out.push_back(p.g); out.push_back(p.b);
+                    }
+                }
+                prev = p;
             }
-        luts_initialized = true;
+        }
+        if(run) out.push_back(OP_RUN | (run - 1));
+        out.insert(out.end(), END_MARKER, END_MARKER + sizeof(END_MARKER));
+        return out;
     }
 
-    // auto init once
-    struct LutBootstrap { LutBootstrap(){ init_luts(); } };
-    static LutBootstrap _lut_bootstrap;
+    // header sanity against the full stream size; one op byte covers at most 62 pixels,
+    // so anything shorter than pixels/62 can't decode and is rejected before allocating
+    void checkHeader(const uint8_t* hdr, uint64_t size, const std::string& what, uint32_t& w, uint32_t& h){
+        if(size < HEADER_SIZE + sizeof(END_MARKER) || std::memcmp(hdr, "qoif", 4) != 0)
+            throw std::runtime_error(what + ": not a QOI file");
+        w = get32(hdr + 4);
+        h = get32(hdr + 8);
+        if(w == 0 || h == 0 || w > std::numeric_limits<uint16_t>::max() || h > std::numeric_limits<uint16_t>::max())
+            throw std::runtime_error(what + ": unsupported QOI dimensions");
+        Validate::dims(w, h, what);
+        Validate::payload(size, HEADER_SIZE + sizeof(END_MARKER) + (uint64_t(w) * h + 61) / 62, what);
+    }
 
-    inline void blendPixel(Mode m, const uint8_t* a, const uint8_t* b, uint8_t* o){
-        // safety net in case someone strips the bootstrap
-        if(!luts_initialized && (m==MULTIPLY || m==SCREEN)) init_luts();
+    Image decode(const uint8_t* data, size_t size, const std::string& what){
+        uint32_t w, h;
+        checkHeader(data, size, what, w, h);
 
-        switch(m){
-            case ADD:
-                for(int i=0;i<Image::PIXEL_SIZE;++i){
-                    int s = a[i] + b[i];
-                    o[i] = (s > 255) ? 255 : s;
+        Image img;
+        img.width   = w;
+        img.height  = h;
+        img.topLeft = true;           // decode in stream order, no flip
+        img.pixels.resize(size_t(img.width) * img.height * Image::PIXEL_SIZE);
+
+        Px index[64] = {};
+        Px p{0,0,0,255};
+        int run = 0;
+        size_t pos = HEADER_SIZE;
+        const size_t end = size - sizeof(END_MARKER);
+        const size_t rowBytes = img.width * Image::PIXEL_SIZE;
+        for(int y = 0; y < img.height; ++y){
+            uint8_t* d = img.pixels.data() + y * rowBytes;
+            for(int x = 0; x < img.width; ++x, d += Image::PIXEL_SIZE){
+                if(run){
+                    --run;
+                }else{
+                    if(pos >= end) throw std::runtime_error(what + ": truncated QOI data");
+                    uint8_t b1 = data[pos++];
+                    if(b1 == OP_RGB){
+                        if(pos + 3 > end) throw std::runtime_error(what + ": truncated QOI data");
+                        p.r = data[pos]; p.g = data[pos+1]; p.b = data[pos+2]; pos += 3;
+                    }else if(b1 == OP_RGBA){
+                        if(pos + 4 > end) throw std::runtime_error(what + ": truncated QOI data");
+                        p.r = data[pos]; p.g = data[pos+1]; p.b = data[pos+2]; p.a = data[pos+3]; pos += 4;
+                    }else if((b1 & MASK_2) == OP_INDEX){
+                        p = index[b1];
+                    }else if((b1 & MASK_2) == OP_DIFF){
+                        p.r += ((b1 >> 4) & 3) - 2;
+                        p.g += ((b1 >> 2) & 3) - 2;
+                        p.b += ( b1       & 3) - 2;
+                    }else if((b1 & MASK_2) == OP_LUMA){
+                        if(pos >= end) throw std::runtime_error(what + ": truncated QOI data");
+                        uint8_t b2 = data[pos++];
+                        int dg = (b1 & 0x3f) - 32;
+                        p.r += dg - 8 + ((b2 >> 4) & 0x0f);
+                        p.g += dg;
+                        p.b += dg - 8 + ( b2       & 0x0f);
+                    }else{
+                        run = b1 & 0x3f;
+                    }
+                    index[hash(p)] = p;
                 }
-                break;
-            case SUBTRACT:
-                for(int i=0;i<Image::PIXEL_SIZE;++i)
-                    o[i] = (a[i] > b[i]) ? (a[i] - b[i]) : 0;
-                break;
-            case MULTIPLY:
-                for(int i=0;i<Image::PIXEL_SIZE;++i)
-                    o[i] = multiply_lut[a[i]][b[i]];
-                break;
-            case SCREEN:
-                for(int i=0;i<Image::PIXEL_SIZE;++i)
-                    o[i] = screen_lut[a[i]][b[i]];
-                break;
-            case OVERLAY:
-                for(int i=0;i<Image::PIXEL_SIZE;++i){
-                    int A = a[i], B = b[i];
-                    int low  = mul255_round(2*A, B);
-                    int high = 255 - mul255_round(2*(255-A), 255-B);
-                    o[i] = (A < 128) ? low : high;
+                d[0] = p.b; d[1] = p.g; d[2] = p.r;
+            }
+        }
+        return img;
+    }
+
+    Image load(const std::string& path){
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if(!file) throw std::runtime_error("Can't open QOI: " + path);
+        const uint64_t size = static_cast<uint64_t>(file.tellg());
+        uint8_t hdr[HEADER_SIZE] = {};
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(hdr), std::min<uint64_t>(size, HEADER_SIZE));
+        uint32_t w, h;
+        checkHeader(hdr, size, path, w, h);
+
+        std::vector<uint8_t> buf(static_cast<size_t>(size));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buf.data()), buf.size());
+        if(!file) throw std::runtime_error(path + ": read failed");
+        return decode(buf.data(), buf.size(), path);
+    }
+
+    void save(const Image& img, const std::string& path){
+        std::vector<uint8_t> buf = encode(img);
+        std::ofstream file(path, std::ios::binary);
+        if(!file) throw std::runtime_error("Can't write QOI: " + path);
+        file.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+        if(!file) throw std::runtime_error("Write failed: " + path);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// PNG output (RGB8, per-row filters, chunked parallel deflate)
+// -----------------------------------------------------------------------------
+namespace PNG {
+    struct Options {
+        int    level      = 1;             // 0 = stored, 1 = fast, up to 9 = longer match search
+        size_t chunkBytes = 256 * 1024;    // independent deflate chunk size (per thread)
+    };
+
+    struct CrcTable {
+        uint32_t v[256];
+        CrcTable(){
+            for(uint32_t i = 0; i < 256; ++i){
+                uint32_t c = i;
+                for(int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+                v[i] = c;
+            }
+        }
+        static const CrcTable& get(){ static const CrcTable t; return t; }   // thread-safe init
+    };
+
+    uint32_t crc32(const uint8_t* p, size_t n, uint32_t crc = 0){
+        const uint32_t* table = CrcTable::get().v;
+        crc = ~crc;
+        for(size_t i = 0; i < n; ++i) crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    uint32_t adler32(const uint8_t* p, size_t n){
+        uint32_t a = 1, b = 0;
+        while(n){
+            size_t k = std::min<size_t>(n, 5552);   // largest block without uint32 overflow
+            n -= k;
+            while(k--){ a += *p++; b += a; }
+            a %= 65521; b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    // --- deflate (RFC 1951) with fixed Huffman codes ---
+    struct BitWriter {
+        std::vector<uint8_t>& out;
+        uint64_t acc = 0;
+        int      n   = 0;
+        explicit BitWriter(std::vector<uint8_t>& o) : out(o) {}
+        void put(uint32_t bits, int count){
+            acc |= uint64_t(bits) << n; n += count;
+            while(n >= 8){ out.push_back(static_cast<uint8_t>(acc)); acc >>= 8; n -= 8; }
+        }
+        void align(){ if(n){ out.push_back(static_cast<uint8_t>(acc)); acc = 0; n = 0; } }
+    };
+
+    struct FixedCodes {
+        uint16_t litCode[288];  uint8_t litLen[288];   // bit-reversed, ready for BitWriter
+        uint16_t lenSym[259];   uint8_t lenExtra[259]; uint16_t lenBase[259];
+        uint8_t  distSym[32769];
+        static constexpr uint16_t LEN_BASE[29]  = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+        static constexpr uint8_t  LEN_EXTRA[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+        static constexpr uint16_t DIST_BASE[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+        static constexpr uint8_t  DIST_EXTRA[30]= {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+        static uint16_t reverse(uint32_t code, int len){
+            uint32_t r = 0;
+            for(int i = 0; i < len; ++i){ r = (r << 1) | (code & 1); code >>= 1; }
+            return static_cast<uint16_t>(r);
+        }
+
+        FixedCodes(){
+            for(int v = 0; v < 288; ++v){
+                uint32_t code; int len;
+                if(v < 144)      { code = 0x30  + v;         len = 8; }
+                else if(v < 256) { code = 0x190 + (v - 144); len = 9; }
+                else if(v < 280) { code = v - 256;           len = 7; }
+                else             { code = 0xc0  + (v - 280); len = 8; }
+                litCode[v] = reverse(code, len); litLen[v] = len;
+            }
+            for(int s = 0; s < 29; ++s){
+                int end = (s == 28) ? 259 : LEN_BASE[s + 1];
+                for(int l = LEN_BASE[s]; l < end; ++l){ lenSym[l] = 257 + s; lenExtra[l] = LEN_EXTRA[s]; lenBase[l] = LEN_BASE[s]; }
+            }
+            for(int s = 0; s < 30; ++s){
+                int end = (s == 29) ? 32769 : DIST_BASE[s + 1];
+                for(int d = DIST_BASE[s]; d < end; ++d) distSym[d] = s;
+            }
+        }
+        static const FixedCodes& get(){ static const FixedCodes c; return c; }
+    };
+
+    // BTYPE=00 blocks of at most 65535 bytes (5 header bytes each), plus the sync flush
+    inline size_t storedSize(size_t n, bool last){
+        size_t blocks = std::max<size_t>(1, (n + 65534) / 65535);
+        return n + blocks * 5 + (last ? 0 : 5);
+    }
+
+    std::vector<uint8_t> storedChunk(const uint8_t* p, size_t n, bool last){
+        std::vector<uint8_t> out;
+        BitWriter bw(out);
+        out.reserve(storedSize(n, last));
+        size_t pos = 0;
+        do{
+            size_t len = std::min<size_t>(n - pos, 65535);
+            bool final = last && pos + len == n;
+            bw.put(final ? 1 : 0, 3);
+            bw.align();
+            out.push_back(len & 0xff);  out.push_back(len >> 8);
+            out.push_back(~len & 0xff); out.push_back((~len >> 8) & 0xff);
+            out.insert(out.end(), p + pos, p + pos + len);
+            pos += len;
+        }while(pos < n);
+        if(!last){ bw.put(0, 3); bw.align(); out.insert(out.end(), {0x00, 0x00, 0xff, 0xff}); }
+        return out;
+    }
+
+    // compress [p, p+n) without referencing earlier data, so chunks can run in parallel;
+    // non-final chunks end with an empty stored block to land on a byte boundary
+    std::vector<uint8_t> deflateChunk(const uint8_t* p, size_t n, int level, bool last){
+        if(level <= 0) return storedChunk(p, n, last);
+
+        std::vector<uint8_t> out;
+        BitWriter bw(out);
+        const FixedCodes& fc = FixedCodes::get();
+        constexpr int    HASH_BITS = 15;
+        constexpr size_t WINDOW    = 32768;
+        constexpr int    MIN_MATCH = 3, MAX_MATCH = 258;
+        const int maxChain = level <= 1 ? 1 : (4 << (level - 2));
+        std::vector<int32_t> head(size_t(1) << HASH_BITS, -1);
+        std::vector<int32_t> prev(level > 1 ? WINDOW : 0);
+        out.reserve(n / 2);
+
+        auto hash3 = [&](size_t i){
+            uint32_t v = (uint32_t(p[i]) << 16) | (uint32_t(p[i+1]) << 8) | p[i+2];
+            return (v * 2654435761u) >> (32 - HASH_BITS);
+        };
+        auto insert = [&](size_t i){
+            uint32_t h = hash3(i);
+            if(level > 1) prev[i & (WINDOW - 1)] = head[h];
+            int32_t cand = head[h];
+            head[h] = static_cast<int32_t>(i);
+            return cand;
+        };
+
+        bw.put(last ? 1 : 0, 1);
+        bw.put(1, 2);                                  // BTYPE=01 fixed Huffman
+        size_t i = 0;
+        while(i < n){
+            int bestLen = 0; size_t bestDist = 0;
+            if(i + MIN_MATCH <= n){
+                int32_t cand = insert(i);
+                int maxLen = static_cast<int>(std::min<size_t>(MAX_MATCH, n - i));
+                for(int chain = 0; cand >= 0 && chain < maxChain; ++chain){
+                    size_t dist = i - cand;
+                    if(dist > WINDOW) break;
+                    const uint8_t* a = p + i; const uint8_t* b = p + cand;
+                    if(b[bestLen] == a[bestLen]){
+                        int l = 0;
+                        while(l < maxLen && a[l] == b[l]) ++l;
+                        if(l > bestLen){ bestLen = l; bestDist = dist; if(l == maxLen) break; }
+                    }
+                    if(level <= 1) break;
+                    int32_t nxt = prev[cand & (WINDOW - 1)];
+                    if(nxt >= cand) break;             // slot reused by a newer position
+                    cand = nxt;
                 }
-                break;
+            }
+            if(bestLen >= MIN_MATCH){
+                int ls = fc.lenSym[bestLen];
+                bw.put(fc.litCode[ls], fc.litLen[ls]);
+                if(fc.lenExtra[bestLen]) bw.put(bestLen - fc.lenBase[bestLen], fc.lenExtra[bestLen]);
+                int ds = fc.distSym[bestDist];
+                bw.put(FixedCodes::reverse(ds, 5), 5);
+                if(FixedCodes::DIST_EXTRA[ds]) bw.put(static_cast<uint32_t>(bestDist - FixedCodes::DIST_BASE[ds]), FixedCodes::DIST_EXTRA[ds]);
+                if(level > 1)
+                    for(size_t k = i + 1; k < i + bestLen && k + MIN_MATCH <= n; ++k) insert(k);
+                i += bestLen;
+            }else{
+                bw.put(fc.litCode[p[i]], fc.litLen[p[i]]);
+                ++i;
+            }
+        }
+        bw.put(fc.litCode[256], fc.litLen[256]);       // end of block
+        if(!last){ bw.put(0, 3); bw.align(); out.insert(out.end(), {0x00, 0x00, 0xff, 0xff}); }
+        bw.align();
+        // incompressible data (noise) costs up to 9 bits per literal; store it instead
+        if(out.size() > storedSize(n, last)) return storedChunk(p, n, last);
+        return out;
+    }
+
+    // --- scanline filtering ---
+    inline uint8_t paeth(int a, int b, int c){
+        int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+    }
+
+    // filter one RGB row into dst (dst[0] = filter type), choosing the filter with the
+    // smallest sum of absolute signed residuals; the top row only tries None/Sub
+    void filterRow(const uint8_t* cur, const uint8_t* up, size_t rowBytes, uint8_t* dst, std::vector<uint8_t>& scratch){
+        constexpr size_t BPP = 3;
+        scratch.resize(rowBytes);
+        uint32_t bestScore = std::numeric_limits<uint32_t>::max();
+        auto trial = [&](uint8_t type, auto predict){
+            uint32_t score = 0;
+            for(size_t i = 0; i < rowBytes; ++i){
+                uint8_t v = cur[i] - predict(i);
+                scratch[i] = v;
+                score += (v < 128) ? v : 256 - v;
+            }
+            if(score < bestScore){
+                bestScore = score;
+                dst[0] = type;
+                std::memcpy(dst + 1, scratch.data(), rowBytes);
+            }
+        };
+        auto left = [&](size_t i) -> int { return i >= BPP ? cur[i - BPP] : 0; };
+        trial(0, [](size_t){ return 0; });
+        trial(1, left);
+        if(up){
+            trial(2, [&](size_t i){ return up[i]; });
+            trial(3, [&](size_t i){ return (left(i) + up[i]) >> 1; });
+            trial(4, [&](size_t i){ return paeth(left(i), up[i], i >= BPP ? up[i - BPP] : 0); });
+        }
+    }
+
+    std::vector<uint8_t> encode(const Image& img, const Options& opt = Options()){
+        // PNG rows are top-down RGB; memory is BGR in either row order
+        const size_t rowBytes = img.width * Image::PIXEL_SIZE;
+        const size_t lineBytes = rowBytes + 1;
+        std::vector<uint8_t> raw(lineBytes * img.height);
+        Parallel::forRange(img.height, [&](size_t y0, size_t y1){
+            std::vector<uint8_t> cur(rowBytes), up(rowBytes), scratch;
+            auto toRGB = [&](size_t y, uint8_t* d){
+                const uint8_t* s = img.pixels.data() + img.memRow(img.height - 1 - static_cast<int>(y)) * rowBytes;
+                for(size_t i = 0; i < rowBytes; i += 3){ d[i] = s[i+2]; d[i+1] = s[i+1]; d[i+2] = s[i]; }
+            };
+            if(y0 > 0) toRGB(y0 - 1, up.data());
+            for(size_t y = y0; y < y1; ++y){
+                toRGB(y, cur.data());
+                uint8_t* dst = raw.data() + y * lineBytes;
+                if(opt.level <= 0){ dst[0] = 0; std::memcpy(dst + 1, cur.data(), rowBytes); }
+                else filterRow(cur.data(), y ? up.data() : nullptr, rowBytes, dst, scratch);
+                cur.swap(up);
+            }
+        });
+
+        const size_t chunk = std::max<size_t>(opt.chunkBytes, 1);
+        const size_t nChunks = std::max<size_t>((raw.size() + chunk - 1) / chunk, 1);
+        std::vector<std::vector<uint8_t>> parts(nChunks);
+        Parallel::forRange(nChunks, [&](size_t c0, size_t c1){
+            for(size_t c = c0; c < c1; ++c){
+                size_t b = c * chunk, e = std::min(raw.size(), b + chunk);
+                parts[c] = deflateChunk(raw.data() + b, e - b, opt.level, c + 1 == nChunks);
+            }
+        });
+
+        std::vector<uint8_t> idat = {0x78, 0x01};     // zlib header, 32K window
+        for(auto& part : parts) idat.insert(idat.end(), part.begin(), part.end());
+        uint32_t adler = adler32(raw.data(), raw.size());
+        idat.insert(idat.end(), {uint8_t(adler >> 24), uint8_t(adler >> 16), uint8_t(adler >> 8), uint8_t(adler)});
+
+        std::vector<uint8_t> out = {0x89,'P','N','G','\r','\n',0x1a,'\n'};
+        auto writeChunk = [&](const char* type, const std::vector<uint8_t>& data){
+            QOI::put32(out, static_cast<uint32_t>(data.size()));
+            size_t start = out.size();
+            out.insert(out.end(), type, type + 4);
+            out.insert(out.end(), data.begin(), data.end());
+            QOI::put32(out, crc32(out.data() + start, out.size() - start));
+        };
+        std::vector<uint8_t> ihdr;
+        QOI::put32(ihdr, img.width);
+        QOI::put32(ihdr, img.height);
+        ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0});     // 8-bit, truecolor, deflate, adaptive, no interlace
+        writeChunk("IHDR", ihdr);
+        writeChunk("IDAT", idat);
+        writeChunk("IEND", {});
+        return out;
+    }
+
+    void save(const Image& img, const std::string& path, const Options& opt = Options()){
+        std::vector<uint8_t> buf = encode(img, opt);
+        std::ofstream file(path, std::ios::binary);
+        if(!file) throw std::runtime_error("Can't write PNG: " + path);
+        file.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+        if(!file) throw std::runtime_error("Write failed: " + path);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Mipmap pyramid (2x box downsampling)
+// -----------------------------------------------------------------------------
+namespace Pyramid {
+    // halve each dimension (rounding up); odd trailing rows/columns are replicated
+    Image downsample2x(const Image& src){
+        Image out;
+        out.width   = std::max(1, (src.width  + 1) / 2);
+        out.height  = std::max(1, (src.height + 1) / 2);
+        out.topLeft = src.topLeft;
+        out.pixels.resize(size_t(out.width) * out.height * Image::PIXEL_SIZE);
+        if(src.pixels.empty()) return out;
+
+        const size_t srcRow = src.width * Image::PIXEL_SIZE;
+        const size_t dstRow = out.width * Image::PIXEL_SIZE;
+        const int pairs = src.width / 2;     // full 2x2 blocks per row
+        Parallel::forRange(out.height, [&](size_t y0, size_t y1){
+            for(size_t y = y0; y < y1; ++y){
+                // pair logical rows so an odd top row is replicated whatever the storage order
+                const uint8_t* r0 = src.pixels.data() + src.memRow(2 * y) * srcRow;
+                const uint8_t* r1 = (2 * y + 1 < src.height) ? src.pixels.data() + src.memRow(2 * y + 1) * srcRow : r0;
+                uint8_t* d = out.pixels.data() + out.memRow(y) * dstRow;
+                // plain byte loop over 2x2 BGR blocks
+                for(int x = 0; x < pairs; ++x){
+                    const uint8_t* a = r0 + x * 6; const uint8_t* b = r1 + x * 6;
+                    uint8_t* o = d + x * 3;
+                    o[0] = (a[0] + a[3] + b[0] + b[3] + 2) >> 2;
+                    o[1] = (a[1] + a[4] + b[1] + b[4] + 2) >> 2;
+                    o[2] = (a[2] + a[5] + b[2] + b[5] + 2) >> 2;
+                }
+                if(src.width & 1){
+                    const uint8_t* a = r0 + pairs * 6; const uint8_t* b = r1 + pairs * 6;
+                    uint8_t* o = d + pairs * 3;
+                    for(int c = 0; c < 3; ++c) o[c] = (a[c] + b[c] + 1) >> 1;
+                }
+            }
+        });
+        return out;
+    }
+
+    // level 0 is the source itself; stops early once a 1x1 level is reached
+    std::vector<Image> build(const Image& src, int levels){
+        std::vector<Image> out;
+        out.push_back(src);
+        for(int l = 1; l < levels && (out.back().width > 1 || out.back().height > 1); ++l)
+            out.push_back(downsample2x(out.back()));
+        return out;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Resampling (separable, fixed-point weights)
+// -----------------------------------------------------------------------------
+namespace Resample {
+    enum Filter { NEAREST, BILINEAR, LANCZOS3 };
+
+    constexpr int PRECISION = 14;      // weight fraction bits
+
+    // per output sample: first source index and `taps` fixed-point weights summing to 1<<PRECISION
+    struct Weights {
+        int taps = 0;
+        std::vector<int>     start;
+        std::vector<int32_t> coef;     // start.size() * taps
+    };
+
+    inline double kernel(Filter f, double x){
+        x = std::fabs(x);
+        if(f == BILINEAR) return x < 1.0 ? 1.0 - x : 0.0;
+        if(x < 1e-8) return 1.0;
+        if(x >= 3.0) return 0.0;
+        const double pi = 3.14159265358979323846;
+        return 3.0 * std::sin(pi * x) * std::sin(pi * x / 3.0) / (pi * pi * x * x);
+    }
+
+    Weights makeWeights(int srcLen, int dstLen, Filter f){
+        Weights w;
+        const double scale  = double(srcLen) / dstLen;
+        const double stretch = std::max(scale, 1.0);             // widen the kernel when minifying
+        const double radius = (f == NEAREST) ? 0.5 : (f == BILINEAR ? 1.0 : 3.0) * stretch;
+        w.taps = (f == NEAREST) ? 1 : std::min(srcLen, static_cast<int>(std::ceil(radius)) * 2 + 1);
+        w.start.resize(dstLen);
+        w.coef.assign(size_t(dstLen) * w.taps, 0);
+
+        std::vector<double> tmp(w.taps);
+        for(int i = 0; i < dstLen; ++i){
+            const double center = (i + 0.5) * scale;
+            int32_t* c = w.coef.data() + size_t(i) * w.taps;
+            if(f == NEAREST){
+                w.start[i] = std::min(srcLen - 1, static_cast<int>(center));
+                c[0] = 1 << PRECISION;
+                continue;
+            }
+            int lo = std::max(0, static_cast<int>(std::floor(center - radius)));
+            int hi = std::min(srcLen, static_cast<int>(std::ceil(center + radius)));
+            if(hi - lo > w.taps) hi = lo + w.taps;
+            double sum = 0;
+            for(int j = lo; j < hi; ++j){ tmp[j - lo] = kernel(f, (j + 0.5 - center) / stretch); sum += tmp[j - lo]; }
+            // taps renormalized so clipped edges keep unit gain
+            int32_t total = 0, bestK = 0;
+            for(int j = lo; j < hi; ++j){
+                int k = j - lo;
+                c[k] = static_cast<int32_t>(std::lround(tmp[k] / sum * (1 << PRECISION)));
+                total += c[k];
+                if(c[k] > c[bestK]) bestK = k;
+            }
+            c[bestK] += (1 << PRECISION) - total;
+            w.start[i] = lo;
+        }
+        // keep every window inside the source so the inner loops need no bounds checks
+        for(int i = 0; i < dstLen; ++i){
+            int over = w.start[i] + w.taps - srcLen;
+            if(over > 0){
+                int32_t* c = w.coef.data() + size_t(i) * w.taps;
+                std::memmove(c + over, c, sizeof(int32_t) * (w.taps - over));
+                std::fill(c, c + over, 0);
+                w.start[i] -= over;
+            }
+        }
+        return w;
+    }
+
+    // the horizontal pass keeps MID_BITS of fraction and its under/overshoot in int16;
+    // only the vertical pass rounds and clamps to bytes
+    constexpr int MID_BITS = 6;
+
+    inline int16_t fixedToMid(int32_t acc){
+        int32_t v = (acc + (1 << (PRECISION - MID_BITS - 1))) >> (PRECISION - MID_BITS);
+        return static_cast<int16_t>(v < -32768 ? -32768 : (v > 32767 ? 32767 : v));
+    }
+
+    inline uint8_t fixedToByte(int32_t acc){
+        return ColorMath::clampByte((acc + (1 << (PRECISION + MID_BITS - 1))) >> (PRECISION + MID_BITS));
+    }
+
+    Image resize(const Image& src, int width, int height, Filter f){
+        if(width <= 0 || height <= 0 || width > std::numeric_limits<uint16_t>::max() || height > std::numeric_limits<uint16_t>::max())
+            throw std::runtime_error("resize: bad target size " + std::to_string(width) + "x" + std::to_string(height));
+        if(src.pixels.empty()) throw std::runtime_error("resize: empty source");
+
+        // horizontal pass: src.height rows of `width` pixels
+        const Weights wx = makeWeights(src.width, width, f);
+        const size_t srcRow = src.width * Image::PIXEL_SIZE, midRow = width * Image::PIXEL_SIZE;
+        std::vector<int16_t> mid(midRow * src.height);
+        Parallel::forRange(src.height, [&](size_t y0, size_t y1){
+            for(size_t y = y0; y < y1; ++y){
+                const uint8_t* s = src.pixels.data() + y * srcRow;
+                int16_t* d = mid.data() + y * midRow;
+                for(int x = 0; x < width; ++x){
+                    const int32_t* c = wx.coef.data() + size_t(x) * wx.taps;
+                    const uint8_t* p = s + wx.start[x] * Image::PIXEL_SIZE;
+                    int32_t b = 0, g = 0, r = 0;
+                    for(int k = 0; k < wx.taps; ++k, p += Image::PIXEL_SIZE){ b += c[k] * p[0]; g += c[k] * p[1]; r += c[k] * p[2]; }
+                    d[x*3+0] = fixedToMid(b); d[x*3+1] = fixedToMid(g); d[x*3+2] = fixedToMid(r);
+                }
+            }
+        });
+
+        // vertical pass: whole rows at a time so the inner loop streams contiguous bytes;
+        // weights index logical rows so either storage order samples the same pixels
+        const Weights wy = makeWeights(src.height, height, f);
+        Image out;
+        out.width   = width;
+        out.height  = height;
+        out.topLeft = src.topLeft;
+        out.pixels.resize(midRow * height);
+        Parallel::forRange(height, [&](size_t y0, size_t y1){
+            std::vector<int32_t> acc(midRow);
+            for(size_t y = y0; y < y1; ++y){
+                std::fill(acc.begin(), acc.end(), 0);
+                const int32_t* c = wy.coef.data() + y * wy.taps;
+                for(int k = 0; k < wy.taps; ++k){
+                    if(!c[k]) continue;
+                    const int16_t* s = mid.data() + src.memRow(wy.start[y] + k) * midRow;
+                    const int32_t ck = c[k];
+                    for(size_t i = 0; i < midRow; ++i) acc[i] += ck * s[i];
+                }
+                uint8_t* d = out.pixels.data() + out.memRow(static_cast<int>(y)) * midRow;
+                for(size_t i = 0; i < midRow; ++i) d[i] = fixedToByte(acc[i]);
+            }
+        });
+        return out;
+    }
+
+    inline Filter parseFilter(const std::string& name){
+        if(name == "nearest")  return NEAREST;
+        if(name == "bilinear") return BILINEAR;
+        if(name == "lanczos")  return LANCZOS3;
+        throw std::runtime_error("unknown filter: " + name + " (nearest|bilinear|lanczos)");
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Spatial filters (separable convolution, box/Gaussian blur, unsharp mask)
+// -----------------------------------------------------------------------------
+// All passes clamp at the edges and run in row bands; each band keeps only a ring of
+// horizontally filtered rows, so the vertical pass never touches more than a few rows.
+namespace Convolve {
+    constexpr int PRECISION = 14;
+
+    inline int clampIndex(int i, int n){ return i < 0 ? 0 : (i >= n ? n - 1 : i); }
+
+    // horizontal running box sum (window 2r+1) of one BGR row, no normalization
+    static void boxRow(const uint8_t* s, int w, int r, int32_t* d){
+        for(int c = 0; c < 3; ++c){
+            int32_t sum = (r + 1) * s[c];
+            for(int k = 1; k <= r; ++k) sum += s[clampIndex(k, w) * 3 + c];
+            for(int x = 0; x < w; ++x){
+                d[x * 3 + c] = sum;
+                sum += s[clampIndex(x + r + 1, w) * 3 + c] - s[clampIndex(x - r, w) * 3 + c];
+            }
+        }
+    }
+
+    // O(1) per pixel regardless of radius: running sums along rows, then down columns.
+    // Row sums fit int32 (255 * (2r+1)); the column sums reach 255 * (2r+1)^2 and need int64.
+    Image boxBlur(const Image& src, int radius){
+        if(radius <= 0 || src.pixels.empty()) return src;
+        const int w = src.width, h = src.height;
+        const size_t rowBytes = w * Image::PIXEL_SIZE;
+        const int64_t area = int64_t(2 * radius + 1) * (2 * radius + 1);
+        const int ringRows = 2 * radius + 2;
+
+        Image out;
+        out.width = src.width; out.height = src.height; out.topLeft = src.topLeft;
+        out.pixels.resize(src.pixels.size());
+        Parallel::forRange(h, [&](size_t y0, size_t y1){
+            std::vector<int32_t> ring(ringRows * rowBytes);
+            std::vector<int64_t> col(rowBytes, 0);
+            const int first = static_cast<int>(y0) - radius;
+            auto row = [&](int j) -> int32_t* {      // logical row j, computed on first use
+                return ring.data() + size_t((j - first) % ringRows) * rowBytes;
+            };
+            for(int j = first; j <= static_cast<int>(y0) + radius; ++j){
+                boxRow(src.pixels.data() + clampIndex(j, h) * rowBytes, w, radius, row(j));
+                const int32_t* r = row(j);
+                for(size_t i = 0; i < rowBytes; ++i) col[i] += r[i];
+            }
+            for(int y = static_cast<int>(y0); y < static_cast<int>(y1); ++y){
+                uint8_t* d = out.pixels.data() + size_t(y) * rowBytes;
+                for(size_t i = 0; i < rowBytes; ++i) d[i] = static_cast<uint8_t>((col[i] + area / 2) / area);
+                if(y + 1 == static_cast<int>(y1)) break;
+                int in = y + radius + 1;
+                boxRow(src.pixels.data() + clampIndex(in, h) * rowBytes, w, radius, row(in));
+                const int32_t* add = row(in);
+                const int32_t* sub = row(y - radius);
+                for(size_t i = 0; i < rowBytes; ++i) col[i] += add[i] - sub[i];
+            }
+        });
+        return out;
+    }
+
+    // box radii whose repeated application approximates a Gaussian of the given sigma
+    std::vector<int> gaussianBoxRadii(double sigma, int passes = 3){
+        double ideal = std::sqrt(12.0 * sigma * sigma / passes + 1.0);
+        int wl = static_cast<int>(std::floor(ideal));
+        if(wl % 2 == 0) --wl;
+        int wu = wl + 2;
+        double mIdeal = (12.0 * sigma * sigma - passes * wl * wl - 4.0 * passes * wl - 3.0 * passes) / (-4.0 * wl - 4.0);
+        int m = static_cast<int>(std::lround(mIdeal));
+        std::vector<int> radii;
+        for(int i = 0; i < passes; ++i) radii.push_back(((i < m ? wl : wu) - 1) / 2);
+        return radii;
+    }
+
+    Image gaussianBlur(const Image& src, double sigma){
+        Image out = src;
+        if(sigma <= 0) return out;
+        for(int r : gaussianBoxRadii(sigma)) out = boxBlur(out, r);
+        return out;
+    }
+
+    // arbitrary odd-length 1-D kernel applied along x then y (weights need not be positive);
+    // rows are logical (bottom-left), so an asymmetric kernel means the same for either storage order
+    Image separable(const Image& src, const std::vector<float>& kernel){
+        if(kernel.empty() || kernel.size() % 2 == 0) throw std::runtime_error("separable: kernel length must be odd");
+        if(src.pixels.empty()) return src;
+        const int w = src.width, h = src.height, taps = static_cast<int>(kernel.size()), r = taps / 2;
+        const size_t rowBytes = w * Image::PIXEL_SIZE;
+        std::vector<int32_t> k(taps);
+        for(int i = 0; i < taps; ++i) k[i] = static_cast<int32_t>(std::lround(kernel[i] * (1 << PRECISION)));
+
+        Image out;
+        out.width = src.width; out.height = src.height; out.topLeft = src.topLeft;
+        out.pixels.resize(src.pixels.size());
+        Parallel::forRange(h, [&](size_t y0, size_t y1){
+            // ring entries keep PRECISION fraction bits so the vertical pass rounds only once
+            std::vector<int32_t> ring(taps * rowBytes);
+            std::vector<int64_t> acc(rowBytes);
+            const int first = static_cast<int>(y0) - r;
+            auto slot = [&](int j){ return ring.data() + size_t((j - first) % taps) * rowBytes; };
+            auto hpass = [&](int j){
+                const uint8_t* s = src.pixels.data() + src.memRow(clampIndex(j, h)) * rowBytes;
+                int32_t* d = slot(j);
+                for(int x = 0; x < w; ++x)
+                    for(int c = 0; c < 3; ++c){
+                        int32_t a = 0;
+                        for(int t = 0; t < taps; ++t) a += k[t] * s[clampIndex(x + t - r, w) * 3 + c];
+                        d[x * 3 + c] = a;
+                    }
+            };
+            for(int j = first; j < static_cast<int>(y0) + r; ++j) hpass(j);
+            for(int y = static_cast<int>(y0); y < static_cast<int>(y1); ++y){
+                hpass(y + r);
+                std::fill(acc.begin(), acc.end(), 0);
+                for(int t = 0; t < taps; ++t){
+                    const int32_t* s = slot(y + t - r);
+                    for(size_t i = 0; i < rowBytes; ++i) acc[i] += int64_t(k[t]) * s[i];
+                }
+                uint8_t* d = out.pixels.data() + out.memRow(y) * rowBytes;
+                const int64_t half = int64_t(1) << (2 * PRECISION - 1);
+                for(size_t i = 0; i < rowBytes; ++i){
+                    int64_t v = (acc[i] + half) >> (2 * PRECISION);
+                    d[i] = ColorMath::clampByte(static_cast<int>(std::max<int64_t>(-1, std::min<int64_t>(256, v))));
+                }
+            }
+        });
+        return out;
+    }
+
+    // out = src + amount * (src - blur); differences within `threshold` are left alone
+    Image unsharp(const Image& src, double sigma, double amount, int threshold = 0){
+        Image blur = gaussianBlur(src, sigma);
+        const int32_t a = static_cast<int32_t>(std::lround(amount * 256));
+        Parallel::forRange(src.pixels.size(), [&](size_t b, size_t e){
+            for(size_t i = b; i < e; ++i){
+                int diff = src.pixels[i] - blur.pixels[i];
+                if(std::abs(diff) <= threshold){ blur.pixels[i] = src.pixels[i]; continue; }
+                blur.pixels[i] = ColorMath::clampByte(src.pixels[i] + ((diff * a + 128) >> 8));
+            }
+        });
+        return blur;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Histogram / channel statistics
+// -----------------------------------------------------------------------------
+namespace Stats {
+    struct Channel {
+        uint64_t hist[256] = {};
+        uint8_t  min = 0, max = 0;
+        double   mean = 0, stddev = 0;
+    };
+    struct Result {
+        uint64_t pixels = 0;
+        Channel  ch[3];              // B, G, R
+    };
+
+    // one pass: per-thread sub-histograms merged at the end; everything else derives from them
+    Result compute(const Image& img){
+        Result res;
+        const size_t n = size_t(img.width) * img.height;
+        res.pixels = n;
+        const unsigned t = Parallel::threadCount(n);
+        std::vector<uint32_t> sub(size_t(t) * 3 * 256, 0);
+        Parallel::forSlots(n, [&](unsigned slot, size_t b, size_t e){
+            uint32_t* h = sub.data() + size_t(slot) * 3 * 256;
+            const uint8_t* p = img.pixels.data() + b * Image::PIXEL_SIZE;
+            for(size_t i = b; i < e; ++i, p += Image::PIXEL_SIZE){ ++h[p[0]]; ++h[256 + p[1]]; ++h[512 + p[2]]; }
+        });
+        for(unsigned k = 0; k < t; ++k)
+            for(int c = 0; c < 3; ++c)
+                for(int v = 0; v < 256; ++v) res.ch[c].hist[v] += sub[(size_t(k) * 3 + c) * 256 + v];
+
+        for(Channel& c : res.ch){
+            if(!n) break;
+            int lo = 0, hi = 255;
+            while(!c.hist[lo]) ++lo;
+            while(!c.hist[hi]) --hi;
+            c.min = lo; c.max = hi;
+            double sum = 0, sq = 0;
+            for(int v = 0; v < 256; ++v){ sum += double(v) * c.hist[v]; sq += double(v) * v * c.hist[v]; }
+            c.mean   = sum / n;
+            c.stddev = std::sqrt(std::max(0.0, sq / n - c.mean * c.mean));
+        }
+        return res;
+    }
+
+    void print(std::ostream& os, const Result& r, const std::string& label, bool withHistogram = false){
+        static const char* names[3] = {"B", "G", "R"};
+        os << label << ": " << r.pixels << " pixels\n";
+        for(int c = 2; c >= 0; --c){
+            const Channel& ch = r.ch[c];
+            os << "  " << names[c] << "  min=" << int(ch.min) << " max=" << int(ch.max)
+               << " mean=" << ch.mean << " stddev=" << ch.stddev << "\n";
+            if(withHistogram){
+                os << "  " << names[c] << "  hist=";
+                for(int v = 0; v < 256; ++v) os << ch.hist[v] << (v < 255 ? "," : "\n");
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Contrast normalization via per-channel point LUTs (histogram pass + LUT pass)
+// -----------------------------------------------------------------------------
+namespace Levels {
+    struct Lut { uint8_t ch[3][256]; };      // B, G, R
+
+    void applyLut(Image& img, const Lut& lut){
+        Parallel::forRange(size_t(img.width) * img.height, [&](size_t b, size_t e){
+            uint8_t* p = img.pixels.data() + b * Image::PIXEL_SIZE;
+            for(size_t i = b; i < e; ++i, p += Image::PIXEL_SIZE){
+                p[0] = lut.ch[0][p[0]]; p[1] = lut.ch[1][p[1]]; p[2] = lut.ch[2][p[2]];
+            }
+        });
+    }
+
+    // stretch [lo, hi] to [0, 255], where lo/hi skip `clip` (0..0.5) of the pixels at each end
+    Lut autoLevelsLut(const Stats::Result& st, double clip = 0.0){
+        Lut lut;
+        const uint64_t skip = static_cast<uint64_t>(st.pixels * std::max(0.0, std::min(0.5, clip)));
+        for(int c = 0; c < 3; ++c){
+            const uint64_t* h = st.ch[c].hist;
+            int lo = 0, hi = 255;
+            for(uint64_t acc = 0; lo < 255 && (acc += h[lo]) <= skip; ) ++lo;
+            for(uint64_t acc = 0; hi > 0   && (acc += h[hi]) <= skip; ) --hi;
+            for(int v = 0; v < 256; ++v){
+                if(hi <= lo){ lut.ch[c][v] = v; continue; }
+                lut.ch[c][v] = ColorMath::clampByte(((v - lo) * 255 + (hi - lo) / 2) / (hi - lo));
+            }
+        }
+        return lut;
+    }
+
+    // classic CDF equalization, per channel
+    Lut equalizeLut(const Stats::Result& st){
+        Lut lut;
+        for(int c = 0; c < 3; ++c){
+            const uint64_t* h = st.ch[c].hist;
+            uint64_t cdfMin = 0;
+            for(int v = 0; v < 256 && !cdfMin; ++v) cdfMin = h[v];
+            const uint64_t range = st.pixels - cdfMin;
+            uint64_t cdf = 0;
+            for(int v = 0; v < 256; ++v){
+                cdf += h[v];
+                lut.ch[c][v] = range ? static_cast<uint8_t>(((cdf - std::min(cdf, cdfMin)) * 255 + range / 2) / range) : v;
+            }
+        }
+        return lut;
+    }
+
+    void autoLevels(Image& img, double clip = 0.0){ applyLut(img, autoLevelsLut(Stats::compute(img), clip)); }
+    void equalize(Image& img){ applyLut(img, equalizeLut(Stats::compute(img))); }
+}
+
+// -----------------------------------------------------------------------------
+// Color spaces (fixed point, converted in place; channel slots 0/1/2 hold Y/Cb/Cr or H/S/V)
+// -----------------------------------------------------------------------------
+namespace ColorSpace {
+    enum Space { BGR, YCBCR, HSV };
+
+    // full-range BT.601 (JPEG) YCbCr
+    inline void bgrToYcc(const uint8_t* p, uint8_t* o){
+        int b = p[0], g = p[1], r = p[2];
+        o[0] = ColorMath::luma(b, g, r);
+        o[1] = ColorMath::clampByte((-43 * r -  85 * g + 128 * b + 32896) >> 8);   // pure blue reaches 256
+        o[2] = ColorMath::clampByte((128 * r - 107 * g -  21 * b + 32896) >> 8);   // pure red reaches 256
+    }
+    inline void yccToBgr(const uint8_t* p, uint8_t* o){
+        int y = p[0] << 16, cb = p[1] - 128, cr = p[2] - 128;
+        const int half = 1 << 15;
+        uint8_t r = ColorMath::clampByte((y + 91881 * cr + half) >> 16);
+        uint8_t g = ColorMath::clampByte((y - 22554 * cb - 46802 * cr + half) >> 16);
+        uint8_t b = ColorMath::clampByte((y + 116130 * cb + half) >> 16);
+        o[0] = b; o[1] = g; o[2] = r;
+    }
+
+    // hue uses the whole byte for one turn (0, 85, 171 ~ red, green, blue)
+    inline void bgrToHsv(const uint8_t* p, uint8_t* o){
+        int b = p[0], g = p[1], r = p[2];
+        int mx = std::max(r, std::max(g, b)), mn = std::min(r, std::min(g, b)), d = mx - mn;
+        int h = 0;
+        if(d){
+            int sector, x;
+            if(mx == r)      { sector = (g < b) ? 6 : 0; x = g - b; }
+            else if(mx == g) { sector = 2; x = b - r; }
+            else             { sector = 4; x = r - g; }
+            h = (((sector * d + x) * 256 + 3 * d) / (6 * d)) & 255;
+        }
+        o[0] = static_cast<uint8_t>(h);
+        o[1] = mx ? static_cast<uint8_t>((255 * d + mx / 2) / mx) : 0;
+        o[2] = static_cast<uint8_t>(mx);
+    }
+    inline void hsvToBgr(const uint8_t* p, uint8_t* o){
+        int h6 = p[0] * 6, s = p[1], v = p[2];
+        int sector = h6 >> 8, f = h6 & 255;
+        int lo  = (v * (255 - s) + 127) / 255;
+        int dec = (v * (255 * 256 - s * f) + 255 * 128) / (255 * 256);
+        int inc = (v * (255 * 256 - s * (256 - f)) + 255 * 128) / (255 * 256);
+        int r, g, b;
+        switch(sector){
+            case 0:  r = v;   g = inc; b = lo;  break;
+            case 1:  r = dec; g = v;   b = lo;  break;
+            case 2:  r = lo;  g = v;   b = inc; break;
+            case 3:  r = lo;  g = dec; b = v;   break;
+            case 4:  r = inc; g = lo;  b = v;   break;
+            default: r = v;   g = lo;  b = dec; break;
+        }
+        o[0] = b; o[1] = g; o[2] = r;
+    }
+
+    inline void toSpace(Space s, const uint8_t* p, uint8_t* o){
+        if(s == YCBCR) bgrToYcc(p, o); else if(s == HSV) bgrToHsv(p, o); else std::memcpy(o, p, 3);
+    }
+    inline void fromSpace(Space s, const uint8_t* p, uint8_t* o){
+        if(s == YCBCR) yccToBgr(p, o); else if(s == HSV) hsvToBgr(p, o); else std::memcpy(o, p, 3);
+    }
+
+    // apply fn(pixelInSpace) between a fused to/from conversion, row-parallel
+    template<class F>
+    void inSpace(ImageView v, Space s, F fn){
+        Parallel::forRange(v.height, [&](size_t y0, size_t y1){
+            uint8_t t[3];
+            for(size_t y = y0; y < y1; ++y){
+                uint8_t* p = v.row(y);
+                for(int x = 0; x < v.width; ++x, p += Image::PIXEL_SIZE){
+                    toSpace(s, p, t);
+                    fn(t);
+                    fromSpace(s, t, p);
+                }
+            }
+        });
+    }
+
+    void convert(Image& img, Space from, Space to){
+        if(from == to) return;
+        Parallel::forRange(size_t(img.width) * img.height, [&](size_t b, size_t e){
+            uint8_t* p = img.pixels.data() + b * Image::PIXEL_SIZE;
+            uint8_t t[3];
+            for(size_t i = b; i < e; ++i, p += Image::PIXEL_SIZE){
+                fromSpace(from, p, t);
+                toSpace(to, t, p);
+            }
+        });
+    }
+
+    // gray as BGR with B=G=R=luma
+    Image toGray(const Image& src){
+        Image out;
+        out.width = src.width; out.height = src.height; out.topLeft = src.topLeft;
+        out.pixels.resize(src.pixels.size());
+        Parallel::forRange(size_t(src.width) * src.height, [&](size_t b, size_t e){
+            for(size_t i = b * 3; i < e * 3; i += 3){
+                uint8_t y = ColorMath::luma(src.pixels[i], src.pixels[i+1], src.pixels[i+2]);
+                out.pixels[i] = out.pixels[i+1] = out.pixels[i+2] = y;
+            }
+        });
+        return out;
+    }
+
+    // hue wraps around instead of clamping
+    void addToChannel(ImageView img, Space s, int idx, int delta){
+        const bool wrap = (s == HSV && idx == 0);
+        inSpace(img, s, [&](uint8_t* t){
+            int v = t[idx] + delta;
+            t[idx] = wrap ? static_cast<uint8_t>(v & 255) : ColorMath::clampByte(v);
+        });
+    }
+
+    void scaleChannel(ImageView img, Space s, int idx, float f){
+        inSpace(img, s, [&](uint8_t* t){ t[idx] = ColorMath::clampByte(static_cast<int>(t[idx] * f + 0.5f)); });
+    }
+
+    inline Space parseSpace(const std::string& name){
+        if(name == "rgb" || name == "bgr") return BGR;
+        if(name == "ycc" || name == "ycbcr") return YCBCR;
+        if(name == "hsv") return HSV;
+        throw std::runtime_error("unknown color space: " + name + " (rgb|ycc|hsv)");
+    }
+
+    // channel names per space: r/g/b, y/cb/cr, h/s/v
+    inline int channelIndex(Space s, const std::string& name){
+        std::string n = name;
+        for(char& c : n) if(c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
+        if(s == YCBCR){ if(n == "y") return 0; if(n == "cb") return 1; if(n == "cr") return 2; }
+        if(s == HSV)  { if(n == "h") return 0; if(n == "s")  return 1; if(n == "v")  return 2; }
+        if(s == BGR)  { if(n == "b") return 0; if(n == "g")  return 1; if(n == "r")  return 2; }
+        throw std::runtime_error("unknown channel '" + name + "' for this color space");
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Shared-memory images: named POSIX shm segments holding a small header and BGR rows,
+// so producers and this tool can exchange images without touching the filesystem
+// -----------------------------------------------------------------------------
+namespace Shm {
+    constexpr char     MAGIC[4]     = {'B','G','R','8'};
+    constexpr uint32_t VERSION      = 1;
+    constexpr size_t   HEADER_BYTES = 64;     // payload starts cache-line aligned
+    constexpr size_t   ROW_ALIGN    = 64;
+
+    struct Header {
+        char     magic[4];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint64_t stride;       // bytes between stored rows, >= width * 3
+        uint32_t topLeft;      // rows stored top-down
+        uint32_t reserved;
+    };
+    static_assert(sizeof(Header) <= HEADER_BYTES, "shm header must fit its slot");
+
+    inline bool isShm(const std::string& path){ return path.compare(0, 4, "shm:") == 0; }
+
+    // "shm:frame" -> "/frame" (POSIX names start with a slash)
+    inline std::string segmentName(const std::string& path){
+        std::string n = isShm(path) ? path.substr(4) : path;
+        if(n.empty()) throw std::runtime_error("empty shared-memory name");
+        return n[0] == '/' ? n : "/" + n;
+    }
+
+    // a mapped segment; views point straight into the mapping, so reads and writes
+    // through them cost no copies at all. The geometry comes from the header copy open()
+    // validated, never from the live mapping, which another process may rewrite.
+    struct Segment {
+        uint8_t* base  = nullptr;
+        size_t   bytes = 0;
+        bool     writable = false;
+        Header   hdr{};
+
+        Segment() = default;
+        Segment(const Segment&) = delete;
+        Segment& operator=(const Segment&) = delete;
+        Segment(Segment&& o) noexcept : base(o.base), bytes(o.bytes), writable(o.writable), hdr(o.hdr) { o.base = nullptr; }
+        ~Segment(){
+#ifndef _WIN32
+            if(base) munmap(base, bytes);
+#endif
+        }
+
+        const Header& header() const { return hdr; }
+        uint8_t* rows() const { return base + HEADER_BYTES; }
+
+        ConstImageView view() const{
+            const Header& h = header();
+            const ptrdiff_t st = static_cast<ptrdiff_t>(h.stride);
+            const uint8_t* bottom = rows() + (h.topLeft && h.height ? (h.height - 1) * h.stride : 0);
+            return ConstImageView{bottom, int(h.width), int(h.height), h.topLeft ? -st : st};
+        }
+        ImageView view(){
+            if(!writable) throw std::runtime_error("shared-memory segment is mapped read-only");
+            ConstImageView v = static_cast<const Segment&>(*this).view();
+            return ImageView{const_cast<uint8_t*>(v.data), v.width, v.height, v.stride};
+        }
+    };
+
+#ifdef _WIN32
+    inline Segment open(const std::string&, bool = false){ throw std::runtime_error("shared-memory images need POSIX shm"); }
+    inline Segment create(const std::string&, uint16_t, uint16_t, bool){ throw std::runtime_error("shared-memory images need POSIX shm"); }
+    inline void    publish(Segment&){ throw std::runtime_error("shared-memory images need POSIX shm"); }
+    inline void    remove(const std::string&){ throw std::runtime_error("shared-memory images need POSIX shm"); }
+#else
+    // maps an existing segment after checking its header against its real size
+    inline Segment open(const std::string& path, bool writable = false){
+        const std::string name = segmentName(path);
+        int fd = shm_open(name.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+        if(fd < 0) throw std::runtime_error("Can't open shared memory: " + name);
+        struct stat st{};
+        if(fstat(fd, &st) != 0){ close(fd); throw std::runtime_error(name + ": fstat failed"); }
+        Segment seg;
+        seg.bytes    = static_cast<size_t>(st.st_size);
+        seg.writable = writable;
+        if(seg.bytes < HEADER_BYTES){ close(fd); throw std::runtime_error(name + ": not an image segment"); }
+        void* m = mmap(nullptr, seg.bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(m == MAP_FAILED) throw std::runtime_error(name + ": mmap failed");
+        seg.base = static_cast<uint8_t*>(m);
+
+        if(std::memcmp(seg.base, MAGIC, 4) != 0)
+            throw std::runtime_error(name + ": not an image segment (or not published yet)");
+        std::atomic_thread_fence(std::memory_order_acquire);      // pairs with publish()
+        std::memcpy(&seg.hdr, seg.base, sizeof(Header));         // validate and use this copy only
+        const Header& h = seg.hdr;
+        if(std::memcmp(h.magic, MAGIC, 4) != 0 || h.version != VERSION)
+            throw std::runtime_error(name + ": not an image segment (or not published yet)");
+        if(h.width > std::numeric_limits<uint16_t>::max() || h.height > std::numeric_limits<uint16_t>::max() ||
+           h.stride < uint64_t(h.width) * Image::PIXEL_SIZE)
+            throw std::runtime_error(name + ": bad segment geometry");
+        Validate::dims(h.width, h.height, name);
+        // stride is untrusted: compare rows that fit against height, never stride * height
+        if(h.stride > seg.bytes || (h.stride && (seg.bytes - HEADER_BYTES) / h.stride < h.height))
+            throw std::runtime_error(name + ": truncated (segment holds fewer than " + std::to_string(h.height) + " rows)");
+        return seg;
+    }
+
+    // creates a fresh segment sized for w x h with 64-byte aligned rows. An existing one is
+    // unlinked, never resized, so readers still mapping it keep their frame. The magic stays
+    // zero (open() rejects the segment) until publish() runs after the rows are written.
+    inline Segment create(const std::string& path, uint16_t w, uint16_t h, bool topLeft){
+        const std::string name = segmentName(path);
+        const uint64_t stride = (uint64_t(w) * Image::PIXEL_SIZE + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN;
+        Segment seg;
+        seg.bytes    = HEADER_BYTES + stride * h;
+        seg.writable = true;
+        if(shm_unlink(name.c_str()) != 0 && errno != ENOENT) throw std::runtime_error("Can't replace shared memory: " + name);
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if(fd < 0) throw std::runtime_error("Can't create shared memory: " + name + (errno == EEXIST ? " (another writer created it concurrently)" : ""));
+        if(ftruncate(fd, static_cast<off_t>(seg.bytes)) != 0){ close(fd); throw std::runtime_error(name + ": resize failed"); }
+        void* m = mmap(nullptr, seg.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(m == MAP_FAILED) throw std::runtime_error(name + ": mmap failed");
+        seg.base = static_cast<uint8_t*>(m);
+
+        Header hdr{};
+        hdr.version = VERSION;
+        hdr.width   = w;
+        hdr.height  = h;
+        hdr.stride  = stride;
+        hdr.topLeft = topLeft;
+        std::memcpy(seg.base, &hdr, sizeof(hdr));
+        seg.hdr = hdr;
+        return seg;
+    }
+
+    // makes a created segment visible to open(): rows first, magic last
+    inline void publish(Segment& seg){
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(seg.base, MAGIC, 4);
+        std::memcpy(seg.hdr.magic, MAGIC, 4);
+    }
+
+    inline void remove(const std::string& path){
+        const std::string name = segmentName(path);
+        if(shm_unlink(name.c_str()) != 0) throw std::runtime_error("Can't remove shared memory: " + name);
+    }
+#endif
+
+    // into an owned Image, keeping the segment's row order (one parallel row copy, no file I/O)
+    inline Image load(const std::string& path){
+        Segment seg = open(path);
+        const Header& h = seg.header();
+        Image img;
+        img.width   = static_cast<uint16_t>(h.width);
+        img.height  = static_cast<uint16_t>(h.height);
+        img.topLeft = h.topLeft != 0;
+        img.pixels.resize(size_t(img.width) * img.height * Image::PIXEL_SIZE);
+        const size_t rowBytes = img.width * Image::PIXEL_SIZE;
+        Parallel::forRange(img.height, [&](size_t y0, size_t y1){
+            for(size_t y = y0; y < y1; ++y)
+                std::memcpy(img.pixels.data() + y * rowBytes, seg.rows() + y * h.stride, rowBytes);
+        });
+        return img;
+    }
+
+    inline void save(const Image& img, const std::string& path){
+        Segment seg = create(path, img.width, img.height, img.topLeft);
+        const size_t rowBytes = img.width * Image::PIXEL_SIZE, stride = seg.header().stride;
+        Parallel::forRange(img.height, [&](size_t y0, size_t y1){
+            for(size_t y = y0; y < y1; ++y)
+                std::memcpy(seg.rows() + y * stride, img.pixels.data() + y * rowBytes, rowBytes);
+        });
+        publish(seg);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Format dispatch by file extension (.qoi, .png, shm:<name>, everything else is TGA)
+// -----------------------------------------------------------------------------
+namespace ImageIO {
+    static PNG::Options pngOptions;
+    static int          thumbLevels = 0;     // >0: also write <name>_thumb.<ext>, downsampled this many times
+    static bool         printStats  = false; // print Stats for every saved image
+    static Dither::Mode ditherMode  = Dither::NONE;   // used when saving 16-bit images
+
+    inline bool hasExt(const std::string& path, const std::string& ext){
+        if(path.size() < ext.size()) return false;
+        for(size_t i = 0; i < ext.size(); ++i){
+            char c = path[path.size() - ext.size() + i];
+            if(c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
+            if(c != ext[i]) return false;
+        }
+        return true;
+    }
+
+    // "out/a.tga" + "_thumb" -> "out/a_thumb.tga"
+    inline std::string withSuffix(const std::string& path, const std::string& suffix){
+        size_t dot = path.find_last_of('.'), slash = path.find_last_of("/\\");
+        if(dot == std::string::npos || (slash != std::string::npos && dot < slash)) return path + suffix;
+        return path.substr(0, dot) + suffix + path.substr(dot);
+    }
+
+    Image load(const std::string& path){
+        if(Shm::isShm(path))     return Shm::load(path);
+        if(hasExt(path, ".qoi")) return QOI::load(path);
+        if(hasExt(path, ".png")) throw std::runtime_error(path + ": PNG is output-only");
+        return TGA::load(path);
+    }
+
+    static void write(const Image& img, const std::string& path){
+        if(Shm::isShm(path))     return Shm::save(img, path);
+        if(hasExt(path, ".qoi")) return QOI::save(img, path);
+        if(hasExt(path, ".png")) return PNG::save(img, path, pngOptions);
+        TGA::save(img, path);
+    }
+
+    void save(const Image& img, const std::string& path){
+        write(img, path);
+        if(printStats) Stats::print(std::cout, Stats::compute(img), path);
+        if(thumbLevels > 0){
+            Image t = Pyramid::downsample2x(img);
+            for(int l = 1; l < thumbLevels; ++l) t = Pyramid::downsample2x(t);
+            write(t, withSuffix(path, "_thumb"));
+        }
+    }
+
+    void save(const Image16& img, const std::string& path){
+        save(Dither::quantize(img, ditherMode), path);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Blend ops
+// -----------------------------------------------------------------------------
+namespace Blend {
+    enum Mode { ADD, SUBTRACT, MULTIPLY, SCREEN, OVERLAY };
+
+    static uint8_t multiply_lut[256][256];
+    static uint8_t screen_lut[256][256];
+    static bool    luts_initialized = false;
+
+    // linear-light path: sRGB byte -> 16-bit linear, and 12-bit linear index -> sRGB byte
+    constexpr int LINEAR_INDEX_SHIFT = 4;
+    static uint16_t srgb_to_linear[256];
+    static uint8_t  linear_to_srgb[65536 >> LINEAR_INDEX_SHIFT];
+
+    inline uint8_t mul255_round(int a, int b){ return (a*b + 127) / 255; }
+    inline uint8_t scr255_round(int a, int b){ return 255 - ((255 - a) * (255 - b) + 127) / 255; }
+
+    void init_luts(){
+        if(luts_initialized) return;
+        for(int a=0;a<256;++a)
+            for(int b=0;b<256;++b){
+                multiply_lut[a][b] = mul255_round(a,b);
+                screen_lut[a][b]   = scr255_round(a,b);
+            }
+        for(int v=0; v<256; ++v){
+            double c = v / 255.0;
+            double l = (c <= 0.04045) ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+            srgb_to_linear[v] = static_cast<uint16_t>(std::lround(l * 65535.0));
+        }
+        for(int i=0; i < (65536 >> LINEAR_INDEX_SHIFT); ++i){
+            double l = ((i << LINEAR_INDEX_SHIFT) + (1 << (LINEAR_INDEX_SHIFT - 1))) / 65535.0;
+            double c = (l <= 0.0031308) ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+            linear_to_srgb[i] = ColorMath::clampByte(static_cast<int>(std::lround(c * 255.0)));
+        }
+        luts_initialized = true;
+    }
+
+    // auto init once
+    struct LutBootstrap { LutBootstrap(){ init_luts(); } };
+    static LutBootstrap _lut_bootstrap;
+
+    inline void blendPixel(Mode m, const uint8_t* a, const uint8_t* b, uint8_t* o){
+        // safety net in case someone strips the bootstrap
+        if(!luts_initialized && (m==MULTIPLY || m==SCREEN)) init_luts();
+
+        switch(m){
+            case ADD:
+                for(int i=0;i<Image::PIXEL_SIZE;++i){
+                    int s = a[i] + b[i];
+                    o[i] = (s > 255) ? 255 : s;
+                }
+                break;
+            case SUBTRACT:
+                for(int i=0;i<Image::PIXEL_SIZE;++i)
+                    o[i] = (a[i] > b[i]) ? (a[i] - b[i]) : 0;
+                break;
+            case MULTIPLY:
+                for(int i=0;i<Image::PIXEL_SIZE;++i)
+                    o[i] = multiply_lut[a[i]][b[i]];
+                break;
+            case SCREEN:
+                for(int i=0;i<Image::PIXEL_SIZE;++i)
+                    o[i] = screen_lut[a[i]][b[i]];
+                break;
+            case OVERLAY:
+                for(int i=0;i<Image::PIXEL_SIZE;++i){
+                    int A = a[i], B = b[i];
+                    int low  = mul255_round(2*A, B);
+                    int high = 255 - mul255_round(2*(255-A), 255-B);
+                    o[i] = (A < 128) ? low : high;
+                }
+                break;
+        }
+    }
+
+    // 16-bit math shared by the linear-light and high-precision paths; a = base, b = overlay
+    template<Mode M>
+    inline uint32_t blend16(uint32_t a, uint32_t b){
+        switch(M){
+            case ADD:      return std::min<uint32_t>(a + b, 65535);
+            case SUBTRACT: return a > b ? a - b : 0;
+            case MULTIPLY: return (a * b + 32767) / 65535;
+            case SCREEN:   return 65535 - ((65535 - a) * (65535 - b) + 32767) / 65535;
+            default:       return a < 32768 ? std::min<uint32_t>((2 * a * b + 32767) / 65535, 65535)
+                                            : 65535 - std::min<uint32_t>((2 * (65535 - a) * (65535 - b) + 32767) / 65535, 65535);
+        }
+    }
+
+    template<Mode M>
+    void blendRunLinear(const uint8_t* bp, const uint8_t* tp, uint8_t* op, size_t bytes){
+        for(size_t i=0;i<bytes;++i){
+            uint32_t l = blend16<M>(srgb_to_linear[bp[i]], srgb_to_linear[tp[i]]);
+            op[i] = linear_to_srgb[l >> LINEAR_INDEX_SHIFT];
+        }
+    }
+
+    // decode both layers to linear light, blend, re-encode; the mode switch sits outside the loop
+    void blendRunLinear(Mode m, const uint8_t* bp, const uint8_t* tp, uint8_t* op, size_t bytes){
+        if(!luts_initialized) init_luts();
+        switch(m){
+            case ADD:      blendRunLinear<ADD>     (bp, tp, op, bytes); break;
+            case SUBTRACT: blendRunLinear<SUBTRACT>(bp, tp, op, bytes); break;
+            case MULTIPLY: blendRunLinear<MULTIPLY>(bp, tp, op, bytes); break;
+            case SCREEN:   blendRunLinear<SCREEN>  (bp, tp, op, bytes); break;
+            case OVERLAY:  blendRunLinear<OVERLAY> (bp, tp, op, bytes); break;
+        }
+    }
+
+    // blend one run of w pixels
+    inline void blendSpan(Mode m, const uint8_t* bp, const uint8_t* tp, uint8_t* op, size_t w, bool linear){
+        if(linear){ blendRunLinear(m, bp, tp, op, w * Image::PIXEL_SIZE); return; }
+        for(size_t i=0;i<w;++i){
+            blendPixel(m, bp, tp, op);
+            bp += Image::PIXEL_SIZE;
+            tp += Image::PIXEL_SIZE;
+            op += Image::PIXEL_SIZE;
+        }
+    }
+
+    // works for images, 16-bit images and views alike; `what` names the second operand
+    template<class A, class B>
+    void checkSameSize(const A& base, const B& other, const char* what = "overlay"){
+        if(base.width != other.width || base.height != other.height)
+            throw std::runtime_error(std::string("Blend size mismatch: base (") +
+                                     std::to_string(base.width) + "x" + std::to_string(base.height) +
+                                     ") vs " + what + " (" +
+                                     std::to_string(other.width) + "x" + std::to_string(other.height) + ")");
+    }
+
+    // blend equally sized views row by row; out may alias bot for in-place use
+    void applyView(ConstImageView bot, ConstImageView top, ImageView out, Mode m, bool linear = false){
+        checkSameSize(bot, top);
+        checkSameSize(bot, out, "output");
+        Parallel::forRange(out.height, [&](size_t y0, size_t y1){
+            for(size_t y = y0; y < y1; ++y)
+                blendSpan(m, bot.row(y), top.row(y), out.row(y), out.width, linear);
+        });
+    }
+
+    Image apply(const Image& bot, const Image& top, Mode m, bool linear = false){
+        checkSameSize(bot, top);
+        Image out;
+        out.width   = bot.width;
+        out.height  = bot.height;
+        out.topLeft = bot.topLeft;    // views are logical, so the overlay may be stored either way
+        out.pixels.resize(size_t(out.width) * out.height * Image::PIXEL_SIZE);
+        applyView(bot.view(), top.view(), out.view(), m, linear);
+        return out;
+    }
+
+    // blend only `roi` of two same-sized images, writing into base; nothing outside is touched
+    void applyRegion(Image& base, const Image& top, const Rect& roi, Mode m, bool linear = false){
+        checkSameSize(base, top);
+        ImageView dst = base.view(roi);
+        applyView(dst, top.view(roi), dst, m, linear);
+    }
+
+    // blend a (usually smaller) overlay whose bottom-left corner sits at (x, y) in base, in place;
+    // only the overlapping rows/columns are visited, the overlay may hang off any edge
+    void applyAt(Image& base, const Image& top, int x, int y, Mode m, bool linear = false){
+        // ends in int64 so offsets near INT_MAX can't overflow; past the early return the
+        // overlay overlaps base, so x0 - x and y0 - y fit in int again
+        const int x0 = std::max(0, x), y0 = std::max(0, y);
+        const int x1 = static_cast<int>(std::min<int64_t>(base.width,  int64_t(x) + top.width));
+        const int y1 = static_cast<int>(std::min<int64_t>(base.height, int64_t(y) + top.height));
+        if(x0 >= x1 || y0 >= y1) return;
+        ImageView dst = base.view(Rect{x0, y0, x1 - x0, y1 - y0});
+        applyView(dst, top.view(Rect{x0 - x, y0 - y, x1 - x0, y1 - y0}), dst, m, linear);
+    }
+
+    // overlay is a tile repeated across the base; the wrap is resolved once per row and per
+    // tile-width span, so the inner loop is the same contiguous blend as apply()
+    Image applyTiled(const Image& bot, const Image& tile, Mode m, bool linear = false){
+        if(tile.width == 0 || tile.height == 0) throw std::runtime_error("Blend: empty tile");
+        Image out;
+        out.width   = bot.width;
+        out.height  = bot.height;
+        out.topLeft = bot.topLeft;    // views are logical, so the overlay may be stored either way
+        out.pixels.resize(size_t(out.width) * out.height * Image::PIXEL_SIZE);
+        ConstImageView b = bot.view(), t = tile.view();
+        ImageView o = out.view();
+        Parallel::forRange(o.height, [&](size_t y0, size_t y1){
+            for(size_t y = y0; y < y1; ++y){
+                const uint8_t* trow = t.row(static_cast<int>(y % t.height));
+                for(int x = 0; x < o.width; x += t.width){
+                    size_t span = std::min(t.width, o.width - x);
+                    blendSpan(m, b.row(y) + x * Image::PIXEL_SIZE, trow, o.row(y) + x * Image::PIXEL_SIZE, span, linear);
+                }
+            }
+        });
+        return out;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Canvas operations
+// -----------------------------------------------------------------------------
+namespace Canvas {
+    // grow the canvas by the given margins, filling new pixels with a solid BGR color
+    Image pad(const Image& src, int left, int bottom, int right, int top, const uint8_t bgr[3]){
+        if(left < 0 || bottom < 0 || right < 0 || top < 0) throw std::runtime_error("pad: margins must be >= 0");
+        const int w = src.width + left + right, h = src.height + bottom + top;
+        if(w > std::numeric_limits<uint16_t>::max() || h > std::numeric_limits<uint16_t>::max())
+            throw std::runtime_error("pad: result too large");
+        Image out;
+        out.width = w; out.height = h; out.topLeft = src.topLeft;
+        out.pixels.resize(size_t(w) * h * Image::PIXEL_SIZE);
+        const size_t srcRow = src.width * Image::PIXEL_SIZE;
+        ImageView o = out.view();
+        ConstImageView in = src.view();
+        Parallel::forRange(h, [&](size_t y0, size_t y1){
+            for(size_t y = y0; y < y1; ++y){
+                uint8_t* d = o.row(static_cast<int>(y));
+                for(int x = 0; x < w; ++x){ d[x*3] = bgr[0]; d[x*3+1] = bgr[1]; d[x*3+2] = bgr[2]; }
+                int sy = static_cast<int>(y) - bottom;
+                if(sy >= 0 && sy < src.height)
+                    std::memcpy(d + left * Image::PIXEL_SIZE, in.row(sy), srcRow);
+            }
+        });
+        return out;
+    }
+
+    // "RRGGBB" -> B, G, R
+    inline void parseColor(const std::string& hex, uint8_t bgr[3]){
+        unsigned v = 0;
+        if(hex.size() != 6 || std::sscanf(hex.c_str(), "%6x", &v) != 1) throw std::runtime_error("bad color '" + hex + "' (want RRGGBB)");
+        bgr[2] = (v >> 16) & 0xff; bgr[1] = (v >> 8) & 0xff; bgr[0] = v & 0xff;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Misc operations (6–10)
+// -----------------------------------------------------------------------------
+static void addToChannel(ImageView v, int idx, int delta){
+    for(int y=0;y<v.height;++y){
+        uint8_t* p = v.row(y) + idx;
+        for(int x=0;x<v.width;++x, p+=Image::PIXEL_SIZE) *p = ColorMath::clampByte(*p + delta);
+    }
+}
+
+static void scaleChannel(ImageView v, int idx, float f){
+    for(int y=0;y<v.height;++y){
+        uint8_t* p = v.row(y) + idx;
+        for(int x=0;x<v.width;++x, p+=Image::PIXEL_SIZE) *p = ColorMath::clampByte(static_cast<int>(*p * f + 0.5f));
+    }
+}
+
+static void addToChannel(Image& img, int idx, int delta){ addToChannel(img.view(), idx, delta); }
+static void scaleChannel(Image& img, int idx, float f){ scaleChannel(img.view(), idx, f); }
+
+// materialize a view (crop)
+static Image copyView(ConstImageView v){
+    Image out;
+    out.width = v.width; out.height = v.height;
+    out.pixels.resize(size_t(v.width) * v.height * Image::PIXEL_SIZE);
+    const size_t rowBytes = v.width * Image::PIXEL_SIZE;
+    for(int y=0;y<v.height;++y) std::memcpy(out.pixels.data() + y * rowBytes, v.row(y), rowBytes);
+    return out;
+}
+
+static void splitRGB(const Image& src, Image& r, Image& g, Image& b){
+    auto prep = [&](Image& d){ d.width = src.width; d.height = src.height; d.topLeft = src.topLeft; d.pixels.resize(src.pixels.size()); };
+    prep(r); prep(g); prep(b);
+    for(size_t i=0;i<src.pixels.size(); i+=Image::PIXEL_SIZE){
+        uint8_t B = src.pixels[i+0], G = src.pixels[i+1], R = src.pixels[i+2];
+        r.pixels[i+0]=r.pixels[i+1]=r.pixels[i+2]=R;
+        g.pixels[i+0]=g.pixels[i+1]=g.pixels[i+2]=G;
+        b.pixels[i+0]=b.pixels[i+1]=b.pixels[i+2]=B;
+    }
+}
+
+static Image combineRGB(const Image& r, const Image& g, const Image& b){
+    if(r.width!=g.width || r.width!=b.width || r.height!=g.height || r.height!=b.height)
+        throw std::runtime_error("combine size mismatch");
+    Image out;
+    out.width = r.width; out.height = r.height; out.topLeft = r.topLeft;
+    out.pixels.resize(size_t(out.width)*out.height*Image::PIXEL_SIZE);
+    if(r.topLeft == g.topLeft && r.topLeft == b.topLeft){
+        for(size_t i=0;i<out.pixels.size(); i+=Image::PIXEL_SIZE){
+            out.pixels[i+2] = r.pixels[i]; // R
+            out.pixels[i+1] = g.pixels[i]; // G
+            out.pixels[i+0] = b.pixels[i]; // B
+        }
+        return out;
+    }
+    // mixed storage orders: walk logical rows
+    ConstImageView rv = r.view(), gv = g.view(), bv = b.view();
+    ImageView ov = out.view();
+    for(int y=0;y<out.height;++y){
+        const uint8_t *rp = rv.row(y), *gp = gv.row(y), *bp = bv.row(y);
+        uint8_t* op = ov.row(y);
+        for(int x=0;x<out.width*3;x+=3){ op[x+2] = rp[x]; op[x+1] = gp[x]; op[x] = bp[x]; }
+    }
+    return out;
+}
+
+// reversing storage order is a 180 degree turn for either row order
+static Image rotate180(const Image& src){
+    Image out;
+    out.width = src.width; out.height = src.height; out.topLeft = src.topLeft;
+    out.pixels.resize(src.pixels.size());
+    size_t pix = size_t(src.width) * src.height;
+    for(size_t p=0; p<pix; ++p){
+        size_t q = pix - 1 - p;
+        out.pixels[p*Image::PIXEL_SIZE+0] = src.pixels[q*Image::PIXEL_SIZE+0];
+        out.pixels[p*Image::PIXEL_SIZE+1] = src.pixels[q*Image::PIXEL_SIZE+1];
+        out.pixels[p*Image::PIXEL_SIZE+2] = src.pixels[q*Image::PIXEL_SIZE+2];
+    }
+    return out;
+}
+
+// -----------------------------------------------------------------------------
+// High-precision (16-bit) pipeline: promote on load, blend/adjust in 16 bits, round on save
+// -----------------------------------------------------------------------------
+namespace HP {
+    Image16 promote(const Image& src){
+        Image16 out;
+        out.width = src.width; out.height = src.height; out.topLeft = src.topLeft;
+        out.pixels.resize(src.pixels.size());
+        Parallel::forRange(src.pixels.size(), [&](size_t b, size_t e){
+            for(size_t i = b; i < e; ++i) out.pixels[i] = src.pixels[i] * 257;
+        });
+        return out;
+    }
+
+    Image demote(const Image16& src, Dither::Mode dither = Dither::NONE){
+        return Dither::quantize(src, dither);
+    }
+
+    template<Blend::Mode M>
+    void blendRun(const uint16_t* a, const uint16_t* b, uint16_t* o, size_t n){
+        for(size_t i = 0; i < n; ++i) o[i] = static_cast<uint16_t>(Blend::blend16<M>(a[i], b[i]));
+    }
+
+    Image16 blend(const Image16& bot, const Image16& top, Blend::Mode m){
+        Blend::checkSameSize(bot, top);
+        Image16 out;
+        out.width = bot.width; out.height = bot.height; out.topLeft = bot.topLeft;
+        out.pixels.resize(bot.pixels.size());
+        const uint16_t* a = bot.pixels.data(); const uint16_t* b = top.pixels.data(); uint16_t* o = out.pixels.data();
+        const size_t rowVals = bot.width * Image16::PIXEL_SIZE;
+        const bool flipTop = bot.topLeft != top.topLeft;
+        Parallel::forRange(bot.height, [&](size_t y0, size_t y1){
+            for(size_t y = y0; y < y1; ++y){
+                const size_t s = y * rowVals, t = (flipTop ? bot.height - 1 - y : y) * rowVals;
+                switch(m){
+                    case Blend::ADD:      blendRun<Blend::ADD>     (a + s, b + t, o + s, rowVals); break;
+                    case Blend::SUBTRACT: blendRun<Blend::SUBTRACT>(a + s, b + t, o + s, rowVals); break;
+                    case Blend::MULTIPLY: blendRun<Blend::MULTIPLY>(a + s, b + t, o + s, rowVals); break;
+                    case Blend::SCREEN:   blendRun<Blend::SCREEN>  (a + s, b + t, o + s, rowVals); break;
+                    case Blend::OVERLAY:  blendRun<Blend::OVERLAY> (a + s, b + t, o + s, rowVals); break;
+                }
+            }
+        });
+        return out;
+    }
+
+    // delta is in 8-bit units, as for the byte version
+    void addToChannel(Image16& img, int idx, int delta){
+        const int d = delta * 257;
+        for(size_t i = idx; i < img.pixels.size(); i += Image16::PIXEL_SIZE){
+            int v = img.pixels[i] + d;
+            img.pixels[i] = static_cast<uint16_t>(v < 0 ? 0 : (v > 65535 ? 65535 : v));
+        }
+    }
+
+    void scaleChannel(Image16& img, int idx, float f){
+        for(size_t i = idx; i < img.pixels.size(); i += Image16::PIXEL_SIZE){
+            float v = img.pixels[i] * f + 0.5f;
+            img.pixels[i] = static_cast<uint16_t>(v < 0 ? 0 : (v > 65535.0f ? 65535.0f : v));
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Frame sequences: printf-style name patterns and a load / process / save pipeline
+// -----------------------------------------------------------------------------
+namespace Sequence {
+    struct Range {
+        int first = 0, last = -1;
+        size_t size() const { return last < first ? 0 : size_t(last) - first + 1; }
+    };
+
+    // "a-b" or a single frame "a"
+    inline Range parseRange(const std::string& s){
+        Range r;
+        int n = std::sscanf(s.c_str(), "%d-%d", &r.first, &r.last);
+        if(n == 1) r.last = r.first;
+        if(n < 1 || r.last < r.first) throw std::runtime_error("bad frame range '" + s + "' (want a-b)");
+        return r;
+    }
+
+    inline bool isPattern(const std::string& s){ return s.find('%') != std::string::npos; }
+
+    // expand the single %d / %Nd / %0Nd in pattern; %% is a literal percent sign
+    inline std::string format(const std::string& pattern, int frame){
+        std::string out;
+        bool done = false;
+        for(size_t i = 0; i < pattern.size(); ++i){
+            if(pattern[i] != '%'){ out += pattern[i]; continue; }
+            if(i + 1 < pattern.size() && pattern[i + 1] == '%'){ out += '%'; ++i; continue; }
+            size_t j = i + 1;
+            const bool zero = j < pattern.size() && pattern[j] == '0';
+            int width = 0;
+            while(j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9' && width < 100) width = width * 10 + (pattern[j++] - '0');
+            if(done || j >= pattern.size() || pattern[j] != 'd')
+                throw std::runtime_error("bad sequence pattern '" + pattern + "' (want one %d or %0Nd)");
+            char buf[128];
+            std::snprintf(buf, sizeof(buf), zero ? "%0*d" : "%*d", width, frame);
+            out += buf;
+            done = true;
+            i = j;
+        }
+        if(!done) throw std::runtime_error("sequence pattern '" + pattern + "' has no %d");
+        return out;
+    }
+
+    // bounded, closable hand-off between two pipeline stages
+    template<class T>
+    struct Queue {
+        std::deque<T>           items;
+        size_t                  cap;
+        bool                    closed = false;
+        std::mutex              lock;
+        std::condition_variable notFull, notEmpty;
+
+        explicit Queue(size_t c) : cap(std::max<size_t>(c, 1)) {}
+
+        bool push(T v){
+            std::unique_lock<std::mutex> lk(lock);
+            notFull.wait(lk, [&]{ return closed || items.size() < cap; });
+            if(closed) return false;
+            items.push_back(std::move(v));
+            notEmpty.notify_one();
+            return true;
+        }
+        // false once closed and drained
+        bool pop(T& v){
+            std::unique_lock<std::mutex> lk(lock);
+            notEmpty.wait(lk, [&]{ return closed || !items.empty(); });
+            if(items.empty()) return false;
+            v = std::move(items.front());
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+        void close(){
+            std::lock_guard<std::mutex> lk(lock);
+            closed = true;
+            notFull.notify_all();
+            notEmpty.notify_all();
+        }
+    };
+
+    // three stages, in frame order: a reader thread decodes up to `depth` frames ahead,
+    // the calling thread runs process (whose pixel loops are parallel already), and a
+    // writer thread encodes results. Constant operands live in the callers' captures.
+    // Under a Memory::budget the reader defers the next frame until the bytes a frame
+    // has needed so far (decode + process growth) fit; until one frame has been processed
+    // that is unknown, so it waits for an empty pipeline, which it never stalls. In-place
+    // process steps grow nothing, so "measured" is its own flag rather than growth > 0.
+    // The first exception from any stage stops the pipeline and is rethrown here.
+    template<class Load, class Process, class Save>
+    void run(const Range& r, Load load, Process process, Save save, size_t depth = 2){
+        using In  = decltype(load(r.first));
+        using Out = decltype(process(r.first, std::declval<In&>()));
+        Queue<std::pair<int, In>>  loaded(depth);
+        Queue<std::pair<int, Out>> done(depth);
+        std::atomic<bool>  failed{false};
+        std::exception_ptr error;
+        std::mutex         errorLock;
+        std::mutex              memLock;
+        std::condition_variable memFreed;
+        int                     inFlight = 0;          // frames loaded but not yet saved
+        std::atomic<int64_t>    loadBytes{0}, processBytes{0};
+        std::atomic<bool>       measured{false};      // one frame has been through process
+        auto fail = [&]{
+            {
+                std::lock_guard<std::mutex> lk(errorLock);
+                if(!error) error = std::current_exception();
+            }
+            failed = true;
+            loaded.close();
+            done.close();
+            std::lock_guard<std::mutex> lk(memLock);
+            memFreed.notify_all();
+        };
+        auto grow = [](std::atomic<int64_t>& slot, int64_t v){
+            int64_t cur = slot.load();
+            while(v > cur && !slot.compare_exchange_weak(cur, v)) {}
+        };
+
+        std::thread reader([&]{
+            try{
+                for(int f = r.first; f <= r.last && !failed; ++f){
+                    {
+                        std::unique_lock<std::mutex> lk(memLock);
+                        memFreed.wait(lk, [&]{
+                            return failed || inFlight == 0 || !Memory::budget ||
+                                   (measured && uint64_t(Memory::live() + loadBytes + processBytes) <= Memory::budget);
+                        });
+                        ++inFlight;
+                    }
+                    const int64_t before = Memory::live();
+                    In in = load(f);
+                    grow(loadBytes, Memory::live() - before);
+                    if(!loaded.push({f, std::move(in)})) break;
+                }
+            }catch(...){ fail(); }
+            loaded.close();
+        });
+        std::thread writer([&]{
+            try{
+                std::pair<int, Out> item;
+                while(!failed && done.pop(item)){
+                    save(item.first, item.second);
+                    item = {};
+                    std::lock_guard<std::mutex> lk(memLock);
+                    --inFlight;
+                    memFreed.notify_all();
+                }
+            }catch(...){ fail(); }
+        });
+        try{
+            std::pair<int, In> item;
+            while(!failed && loaded.pop(item)){
+                const int     f      = item.first;
+                const int64_t before = Memory::live();
+                Out out = process(f, item.second);
+                grow(processBytes, Memory::live() - before);
+                item = {};
+                if(!measured){
+                    std::lock_guard<std::mutex> lk(memLock);
+                    measured = true;
+                    memFreed.notify_all();
+                }
+                if(!done.push({f, std::move(out)})) break;
+            }
+        }catch(...){ fail(); }
+        done.close();
+        reader.join();
+        writer.join();
+        if(error) std::rethrow_exception(error);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Temporal ops over frame sequences: sliding-window mean and differencing
+// -----------------------------------------------------------------------------
+namespace Temporal {
+    // the last N frames in a ring plus per-value running sums; pushing a frame adds it
+    // and subtracts the one it evicts in a single pass, whatever the window size
+    struct Window {
+        size_t                capacity;
+        std::vector<Image>    ring;
+        size_t                head  = 0;      // oldest frame once the ring is full
+        size_t                count = 0;
+        std::vector<uint32_t> sum;
+        uint16_t              width = 0, height = 0;
+        bool                  topLeft = false;
+
+        explicit Window(size_t n) : capacity(std::max<size_t>(n, 1)) { ring.reserve(capacity); }
+
+        // frames must match the first one's size; storage order is matched in place
+        void conform(Image& f) const{
+            if(f.width != width || f.height != height)
+                throw std::runtime_error("frame size changed: " + std::to_string(f.width) + "x" + std::to_string(f.height) +
+                                         " vs " + std::to_string(width) + "x" + std::to_string(height));
+            if(f.topLeft != topLeft) f.setOrigin(topLeft);
+        }
+
+        void push(Image f){
+            if(count == 0){
+                width = f.width; height = f.height; topLeft = f.topLeft;
+                sum.assign(f.pixels.size(), 0);
+            }
+            conform(f);
+            uint32_t* s = sum.data();
+            const uint8_t* in = f.pixels.data();
+            if(count < capacity){
+                Parallel::forRange(sum.size(), [&](size_t b, size_t e){
+                    for(size_t i = b; i < e; ++i) s[i] += in[i];
+                });
+                ring.push_back(std::move(f));
+                ++count;
+                return;
+            }
+            const uint8_t* old = ring[head].pixels.data();
+            Parallel::forRange(sum.size(), [&](size_t b, size_t e){
+                for(size_t i = b; i < e; ++i) s[i] += in[i] - old[i];
+            });
+            ring[head] = std::move(f);
+            head = (head + 1) % capacity;
+        }
+
+        // rounded mean of the frames in the window
+        Image mean() const{
+            Image out;
+            out.width = width; out.height = height; out.topLeft = topLeft;
+            out.pixels.resize(sum.size());
+            const uint32_t n = static_cast<uint32_t>(count), half = n / 2;
+            Parallel::forRange(sum.size(), [&](size_t b, size_t e){
+                for(size_t i = b; i < e; ++i) out.pixels[i] = static_cast<uint8_t>((sum[i] + half) / n);
+            });
+            return out;
+        }
+
+        // |f - mean| per value; black while the window is still empty
+        Image diff(Image& f) const{
+            if(count == 0){
+                Image out = f;
+                std::fill(out.pixels.begin(), out.pixels.end(), 0);
+                return out;
+            }
+            conform(f);
+            Image out;
+            out.width = width; out.height = height; out.topLeft = topLeft;
+            out.pixels.resize(sum.size());
+            const uint32_t n = static_cast<uint32_t>(count), half = n / 2;
+            Parallel::forRange(sum.size(), [&](size_t b, size_t e){
+                for(size_t i = b; i < e; ++i){
+                    int d = int(f.pixels[i]) - int((sum[i] + half) / n);
+                    out.pixels[i] = static_cast<uint8_t>(d < 0 ? -d : d);
+                }
+            });
+            return out;
+        }
+    };
+}
+
+// printf-style formatting for reports that go to a caller-chosen stream
+inline std::string formatted(const char* fmt, ...){
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    std::vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return buf;
+}
+
+// -----------------------------------------------------------------------------
+// Worker processes: items [0, n) are pulled from a shared-memory counter by forked
+// children, which report progress to the parent over one pipe each
+// -----------------------------------------------------------------------------
+namespace Workers {
+    struct Stats {
+        size_t items  = 0;
+        size_t failed = 0;
+        double busyMs = 0;     // sum of item times
+        double maxMs  = 0;     // slowest item
+        int64_t peak  = 0;     // largest pixel-byte peak of one item
+    };
+
+    inline double msSince(std::chrono::steady_clock::time_point t0){
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    // one parsed progress line: 'B' began, 'D' done, 'F' failed
+    struct Event {
+        char        kind = 0;
+        size_t      item = 0;
+        double      ms   = 0;
+        long long   peak = 0;  // pixel bytes
+        long long   retained = 0;
+        std::string text;
+    };
+
+    inline Event parseEvent(const std::string& line){
+        Event ev;
+        char msg[256] = {};
+        ev.kind = line.empty() ? 0 : line[0];
+        std::sscanf(line.c_str() + (line.empty() ? 0 : 1),  " %zu %lf %lld %lld %255[^\n]", &ev.item, &ev.ms, &ev.peak, &ev.retained, msg);
+        ev.text = msg;
+        return ev;
+    }
+
+    // parent-side bookkeeping shared by the forked and in-process paths
+    template<class L>
+    struct Report {
+        std::vector<Stats> stats;
+        size_t done = 0, total;
+        L& label;
+        std::ostream& os;
+        Report(unsigned workers, size_t n, L& l, std::ostream& o) : stats(workers), total(n), label(l), os(o) {}
+
+        void apply(unsigned w, const Event& ev){
+            if(ev.kind == 'B') return;
+            Stats& s = stats[w];
+            ++s.items; ++done;
+            s.busyMs += ev.ms;
+            s.maxMs = std::max(s.maxMs, ev.ms);
+            s.peak  = std::max<int64_t>(s.peak, ev.peak);
+            os << "[worker " << w << "] " << label(ev.item);
+            if(ev.kind == 'F'){ ++s.failed; os << " FAILED: " << ev.text; }
+            else os << " done in " << ev.ms << " ms";
+            os << "  (" << done << "/" << total << ")\n";
+        }
+
+        size_t print(double wallMs) const{
+            Stats sum;
+            os << formatted("%-8s %8s %8s %12s %10s %10s\n", "worker", "items", "failed", "busy ms", "max ms", "peak MB");
+            for(size_t w = 0; w < stats.size(); ++w){
+                const Stats& s = stats[w];
+                os << formatted("%-8zu %8zu %8zu %12.1f %10.1f %10.2f\n", w, s.items, s.failed, s.busyMs, s.maxMs, Memory::mb(s.peak));
+                sum.items += s.items; sum.failed += s.failed; sum.busyMs += s.busyMs;
+                sum.maxMs = std::max(sum.maxMs, s.maxMs); sum.peak = std::max(sum.peak, s.peak);
+            }
+            os << formatted("%-8s %8zu %8zu %12.1f %10.1f %10.2f   wall %.1f ms, %.2fx parallel\n", "total",
+                        sum.items, sum.failed, sum.busyMs, sum.maxMs, Memory::mb(sum.peak), wallMs, wallMs > 0 ? sum.busyMs / wallMs : 0.0);
+            return sum.failed + (total - done);
+        }
+    };
+
+    // runs fn(i) for every item on `workers` processes; label(i) names items in the progress
+    // lines and the final table, which go to os.
+    // A crashing item only takes down its own worker. Returns the number of failed items.
+    template<class F, class L>
+    size_t run(size_t n, unsigned workers, F fn, L label, std::ostream& os = std::cout){
+        workers = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(workers, n)));
+        Report<L> report(workers, n, label, os);
+        const auto t0 = std::chrono::steady_clock::now();
+#ifdef _WIN32
+        // no fork(): same accounting, in this process
+        for(size_t i = 0; i < n; ++i){
+            Event ev; ev.item = i; ev.kind = 'D';
+            const auto ti = std::chrono::steady_clock::now();
+            Memory::Stage stage(label(i));
+            try{ fn(i); }catch(const std::exception& e){ ev.kind = 'F'; ev.text = e.what(); }
+            ev.ms   = msSince(ti);
+            ev.peak = stage.peakSoFar();
+            report.apply(0, ev);
+        }
+        return report.print(msSince(t0));
+#else
+        // the work queue and the memory admission state live in anonymous shared memory;
+        // each worker's reservation sits in its own slot so the parent can hand back the
+        // share of a worker that died mid-item
+        struct Slot {
+            int64_t est  = 0;
+            bool    held = false;
+        };
+        struct Shared {
+            std::atomic<size_t>  next{0};
+            std::atomic<int>     lock{0};       // guards reserved/busy and the slots
+            int64_t              reserved = 0;  // estimated bytes of the items running now
+            unsigned             busy     = 0;
+            std::atomic<int64_t> estimate{0};   // largest per-item peak seen so far
+        };
+        const size_t mapBytes = sizeof(Shared) + sizeof(Slot) * workers;
+        void* mem = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if(mem == MAP_FAILED) throw std::runtime_error("workers: mmap failed");
+        Shared* sh = new (mem) Shared();
+        Slot* slots = new (static_cast<char*>(mem) + sizeof(Shared)) Slot[workers];
+
+        auto lock = [sh]{
+            int unlocked = 0;
+            while(!sh->lock.compare_exchange_weak(unlocked, 1)){ unlocked = 0; std::this_thread::yield(); }
+        };
+        // under a budget, an item starts only when the running items' estimated peaks leave
+        // room for one more; until one item has finished the estimate is unknown, so the
+        // first item runs alone. The reservation is recorded in worker w's slot.
+        auto admit = [sh, slots, lock](unsigned w){
+            if(!Memory::budget) return;
+            for(;;){
+                lock();
+                const int64_t est = sh->estimate.load();
+                const bool ok = sh->busy == 0 || (est > 0 && uint64_t(sh->reserved + est) <= Memory::budget);
+                if(ok){ sh->reserved += est; ++sh->busy; slots[w] = Slot{est, true}; }
+                sh->lock.store(0);
+                if(ok) return;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        };
+        // hand back worker w's reservation, if it holds one (the parent calls this for dead workers)
+        auto drop = [sh, slots, lock](unsigned w){
+            if(!Memory::budget) return;
+            lock();
+            if(slots[w].held){ sh->reserved -= slots[w].est; --sh->busy; slots[w].held = false; }
+            sh->lock.store(0);
+        };
+        auto release = [sh, drop](unsigned w, int64_t peak){
+            int64_t cur = sh->estimate.load();
+            while(peak > cur && !sh->estimate.compare_exchange_weak(cur, peak)) {}
+            drop(w);
+        };
+
+        std::vector<pid_t> pids(workers, -1);
+        std::vector<int>   fds(workers, -1);
+        std::cout.flush();
+        // a failed pipe/fork must not leave earlier workers draining the queue unsupervised
+        auto abandon = [&](const char* what){
+            for(unsigned k = 0; k < workers; ++k){
+                if(pids[k] > 0){ kill(pids[k], SIGKILL); waitpid(pids[k], nullptr, 0); }
+                if(fds[k] >= 0) close(fds[k]);
+            }
+            munmap(mem, mapBytes);
+            throw std::runtime_error(std::string("workers: ") + what + " failed");
+        };
+        for(unsigned w = 0; w < workers; ++w){
+            int p[2];
+            if(pipe(p) != 0) abandon("pipe");
+            pid_t pid = fork();
+            if(pid < 0){ close(p[0]); close(p[1]); abandon("fork"); }
+            if(pid == 0){
+                close(p[0]);
+                signal(SIGPIPE, SIG_IGN);
+                auto send = [&](char kind, size_t i, double ms, int64_t peak, int64_t retained, const std::string& text){
+                    char line[320];
+                    int len = std::snprintf(line, sizeof(line), "%c %zu %.3f %lld %lld %.200s\n", kind, i, ms,
+                                            (long long)peak, (long long)retained, text.c_str());
+                    for(char* c = line + 2; c < line + len - 1; ++c) if(*c == '\n') *c = ' ';
+                    if(write(p[1], line, len) < 0) {}
+                };
+                // nothing may unwind past this point: the child must always end in _exit
+                int status = 0;
+                try{
+                    for(;;){
+                        admit(w);
+                        const size_t i = sh->next.fetch_add(1);
+                        if(i >= n){ release(w, 0); break; }
+                        send('B', i, 0, 0, 0, "");
+                        const auto ti = std::chrono::steady_clock::now();
+                        int64_t peak = 0, retained = 0;
+                        try{
+                            // the stage row would die with this process, so its numbers travel
+                            // in the event and the parent records them
+                            Memory::Stage stage(label(i));
+                            auto measure = [&]{ peak = stage.peakSoFar(); retained = Memory::live() - stage.startLive; };
+                            try{ fn(i); }catch(...){ measure(); throw; }
+                            measure();
+                            send('D', i, msSince(ti), peak, retained, "");
+                        }catch(const std::exception& e){
+                            send('F', i, msSince(ti), peak, retained, e.what());
+                            status = 1;
+                        }catch(...){
+                            send('F', i, msSince(ti), peak, retained, "unknown exception");
+                            status = 1;
+                        }
+                        release(w, peak);
+                    }
+                }catch(...){ status = 1; }
+                std::cout.flush();
+                _exit(status);
+            }
+            close(p[1]);
+            pids[w] = pid;
+            fds[w]  = p[0];
+        }
+
+        // stream progress until every pipe hits EOF, remembering what each worker has claimed
+        std::vector<std::string> partial(workers);
+        std::vector<std::vector<size_t>> claimed(workers);
+        for(size_t open = workers; open > 0; ){
+            std::vector<pollfd> pf;
+            for(unsigned w = 0; w < workers; ++w) if(fds[w] >= 0) pf.push_back(pollfd{fds[w], POLLIN, 0});
+            if(poll(pf.data(), pf.size(), -1) < 0) continue;
+            for(const pollfd& q : pf){
+                if(!q.revents) continue;
+                unsigned w = static_cast<unsigned>(std::find(fds.begin(), fds.end(), q.fd) - fds.begin());
+                char buf[4096];
+                ssize_t got = read(q.fd, buf, sizeof(buf));
+                if(got <= 0){ close(q.fd); fds[w] = -1; --open; drop(w); continue; }   // EOF: the worker is gone
+                partial[w].append(buf, got);
+                for(size_t nl; (nl = partial[w].find('\n')) != std::string::npos; ){
+                    Event ev = parseEvent(partial[w].substr(0, nl));
+                    partial[w].erase(0, nl + 1);
+                    auto& c = claimed[w];
+                    if(ev.kind == 'B') c.push_back(ev.item);
+                    else{
+                        c.erase(std::remove(c.begin(), c.end(), ev.item), c.end());
+                        Memory::record(Memory::StageResult{label(ev.item), ev.peak, ev.retained});
+                        int64_t wp = Memory::workerPeak.load();
+                        while(ev.peak > wp && !Memory::workerPeak.compare_exchange_weak(wp, ev.peak)) {}
+                    }
+                    report.apply(w, ev);
+                }
+            }
+        }
+
+        // a worker that died mid-item fails that item; the others carried on without it
+        for(unsigned w = 0; w < workers; ++w){
+            int status = 0;
+            waitpid(pids[w], &status, 0);
+            if(WIFSIGNALED(status))
+                for(size_t i : claimed[w]){
+                    Event ev; ev.kind = 'F'; ev.item = i;
+                    ev.text = "worker killed by signal " + std::to_string(WTERMSIG(status));
+                    report.apply(w, ev);
+                }
+        }
+        munmap(mem, mapBytes);
+        return report.print(msSince(t0));
+#endif
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Hardware counters (Linux perf_event_open): cycles, instructions, cache and branch
+// misses for this process and the worker threads it starts. Any counter the kernel
+// refuses (no PMU in a VM, perf_event_paranoid, other OS) just reads as unavailable.
+// -----------------------------------------------------------------------------
+namespace Perf {
+    enum Event { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, EVENT_COUNT };
+    static const char* const EVENT_NAMES[EVENT_COUNT] = {"cycles", "instructions", "cache-misses", "branch-misses"};
+
+    static bool enabled = false;     // --perf
+
+    struct Counts {
+        double value[EVENT_COUNT] = {};
+        bool   valid[EVENT_COUNT] = {};
+
+        bool   has(Event e) const { return valid[e]; }
+        bool   any() const { return std::any_of(valid, valid + EVENT_COUNT, [](bool v){ return v; }); }
+        double ipc() const { return has(CYCLES) && has(INSTRUCTIONS) && value[CYCLES] > 0 ? value[INSTRUCTIONS] / value[CYCLES] : 0; }
+        Counts& operator/=(double d){ for(double& v : value) v /= d; return *this; }
+    };
+
+    // one counter per event, each inherited by threads created while it runs (Parallel's
+    // pools start per call, so all of an op's threads are counted once they are joined)
+    struct Counters {
+        int         fd[EVENT_COUNT];
+        std::string why;             // first reason a counter could not be opened
+
+        Counters(){
+            for(int& f : fd) f = -1;
+#ifdef __linux__
+            const uint64_t config[EVENT_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                  PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+            for(int e = 0; e < EVENT_COUNT; ++e){
+                perf_event_attr attr{};
+                attr.size           = sizeof(attr);
+                attr.type           = PERF_TYPE_HARDWARE;
+                attr.config         = config[e];
+                attr.disabled       = 1;
+                attr.inherit        = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv     = 1;
+                attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                fd[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+                if(fd[e] < 0 && why.empty()) why = std::string(EVENT_NAMES[e]) + ": " + std::strerror(errno);
+            }
+#else
+            why = "perf_event_open needs Linux";
+#endif
+        }
+        ~Counters(){
+#ifdef __linux__
+            for(int f : fd) if(f >= 0) close(f);
+#endif
         }
-    }
-
-    Image apply(const Image& bot, const Image& top, Mode m){
-        if(bot.width != top.width || bot.height != top.height)
-            throw std::runtime_error("Blend size mismatch: base (" +
-                                     std::to_string(bot.width) + "x" + std::to_string(bot.height) +
-                                     ") vs overlay (" +
-                                     std::to_string(top.width) + "x" + std::to_string(top.height) + ")");
+        Counters(const Counters&) = delete;
+        Counters& operator=(const Counters&) = delete;
 
-        Image out;
-        out.width  = bot.width;
-        out.height = bot.height;
-        out.pixels.resize(out.width * out.height * Image::PIXEL_SIZE);
+        bool any() const { return std::any_of(fd, fd + EVENT_COUNT, [](int f){ return f >= 0; }); }
 
-        const uint8_t* bp = bot.pixels.data();
-        const uint8_t* tp = top.pixels.data();
-        uint8_t*       op = out.pixels.data();
-        size_t n = out.width * out.height;
+        void start(){
+#ifdef __linux__
+            for(int f : fd) if(f >= 0){ ioctl(f, PERF_EVENT_IOC_RESET, 0); ioctl(f, PERF_EVENT_IOC_ENABLE, 0); }
+#endif
+        }
 
-        for(size_t i=0;i<n;++i){
-            blendPixel(m, bp, tp, op);
-            bp += Image::PIXEL_SIZE;
-            tp += Image::PIXEL_SIZE;
-            op += Image::PIXEL_SIZE;
+        // counts since start(), scaled up when the kernel had to multiplex the counters
+        Counts stop(){
+            Counts c;
+#ifdef __linux__
+            for(int e = 0; e < EVENT_COUNT; ++e){
+                if(fd[e] < 0) continue;
+                ioctl(fd[e], PERF_EVENT_IOC_DISABLE, 0);
+                uint64_t v[3] = {};      // value, time enabled, time running
+                if(read(fd[e], v, sizeof(v)) != sizeof(v) || v[2] == 0) continue;
+                c.value[e] = double(v[0]) * (double(v[1]) / double(v[2]));
+                c.valid[e] = true;
+            }
+#endif
+            return c;
         }
+    };
+
+    // "IPC 2.10  0.85 B/cycle  cache-misses 1.2M  branch-misses 10.3k"; bytes 0 skips B/cycle
+    inline std::string describe(const Counts& c, double bytes){
+        auto human = [](double v){
+            char b[32];
+            if(v >= 1e9)      std::snprintf(b, sizeof(b), "%.2fG", v / 1e9);
+            else if(v >= 1e6) std::snprintf(b, sizeof(b), "%.2fM", v / 1e6);
+            else if(v >= 1e3) std::snprintf(b, sizeof(b), "%.1fk", v / 1e3);
+            else              std::snprintf(b, sizeof(b), "%.0f", v);
+            return std::string(b);
+        };
+        std::string out;
+        char b[64];
+        if(c.has(CYCLES) && c.has(INSTRUCTIONS)){ std::snprintf(b, sizeof(b), "IPC %.2f  ", c.ipc()); out += b; }
+        if(c.has(CYCLES) && bytes > 0 && c.value[CYCLES] > 0){ std::snprintf(b, sizeof(b), "%.2f B/cycle  ", bytes / c.value[CYCLES]); out += b; }
+        for(int e = 0; e < EVENT_COUNT; ++e)
+            out += std::string(EVENT_NAMES[e]) + " " + (c.valid[e] ? human(c.value[e]) : std::string("n/a")) + (e + 1 < EVENT_COUNT ? "  " : "");
         return out;
     }
+
+    // --perf around a whole command: counts everything until the end of the scope
+    struct Scope {
+        std::unique_ptr<Counters> counters;
+        explicit Scope(bool on){
+            if(!on) return;
+            counters.reset(new Counters());
+            if(!counters->any()) std::cerr << "perf: counters unavailable (" << counters->why << ")\n";
+            counters->start();
+        }
+        ~Scope(){
+            if(counters && counters->any()) std::cerr << "perf: " << describe(counters->stop(), 0) << "\n";
+        }
+    };
 }
 
 // -----------------------------------------------------------------------------
-// Misc operations (6–10)
+// Synthetic images for benchmarks and soak runs. Every pixel is a pure function of its
+// (bottom-left) coordinates and the parameter, so output is identical for any thread
+// count and either storage order.
 // -----------------------------------------------------------------------------
-static void addToChannel(Image& img, int idx, int delta){
-    for(size_t i=0;i<img.pixels.size(); i+=Image::PIXEL_SIZE){
-        int v = img.pixels[i+idx] + delta;
-        img.pixels[i+idx] = ColorMath::clampByte(v);
+namespace Generate {
+    enum Kind { GRADIENT, NOISE, CHECKER, SOLID, TEXT };
+
+    inline Kind parse(const std::string& name){
+        if(name == "gradient") return GRADIENT;
+        if(name == "noise")    return NOISE;
+        if(name == "checker")  return CHECKER;
+        if(name == "solid")    return SOLID;
+        if(name == "text")     return TEXT;
+        throw std::runtime_error("unknown pattern: " + name + " (gradient|noise|checker|solid|text)");
     }
-}
 
-static void scaleChannel(Image& img, int idx, float f){
-    for(size_t i=0;i<img.pixels.size(); i+=Image::PIXEL_SIZE){
-        int v = static_cast<int>(img.pixels[i+idx] * f + 0.5f);
-        img.pixels[i+idx] = ColorMath::clampByte(v);
+    // stateless 32-bit mix (lowbias32), good enough to look like noise to every codec here
+    inline uint32_t hash(uint32_t x, uint32_t y, uint32_t seed){
+        uint32_t h = x * 0x9e3779b1u ^ (y + 0x7f4a7c15u) * 0x85ebca77u ^ seed * 0xc2b2ae3du;
+        h ^= h >> 16; h *= 0x7feb352du;
+        h ^= h >> 15; h *= 0x846ca68bu;
+        h ^= h >> 16;
+        return h;
     }
-}
 
-static void splitRGB(const Image& src, Image& r, Image& g, Image& b){
-    auto prep = [&](Image& d){ d.width = src.width; d.height = src.height; d.pixels.resize(src.pixels.size()); };
-    prep(r); prep(g); prep(b);
-    for(size_t i=0;i<src.pixels.size(); i+=Image::PIXEL_SIZE){
-        uint8_t B = src.pixels[i+0], G = src.pixels[i+1], R = src.pixels[i+2];
-        r.pixels[i+0]=r.pixels[i+1]=r.pixels[i+2]=R;
-        g.pixels[i+0]=g.pixels[i+1]=g.pixels[i+2]=G;
-        b.pixels[i+0]=b.pixels[i+1]=b.pixels[i+2]=B;
+    struct Params {
+        uint32_t seed    = 1;     // noise, text
+        int      cell    = 32;    // checker square size
+        uint8_t  bgr[3]  = {0, 0, 0};
+    };
+
+    // text: dark 5x7 "glyphs" from hashed bitmaps on a light page, in words and lines;
+    // mostly long background runs with short busy stretches
+    inline void textPixel(int x, int y, int h, uint32_t seed, uint8_t* d){
+        constexpr int GW = 6, GH = 9, LINE = 14, MARGIN = 8;
+        const int row = (h - 1 - y) - MARGIN;                 // lines run top-down
+        uint8_t v = 245;
+        if(row >= 0 && x >= MARGIN){
+            const int line = row / LINE, ly = row % LINE, col = (x - MARGIN) / GW, lx = (x - MARGIN) % GW;
+            const uint32_t g = hash(col, line, seed);
+            const bool lineUsed = (hash(0, line, seed ^ 0x5bd1e995u) & 7) != 0;       // some blank lines
+            const bool isGlyph  = lineUsed && (g & 7) != 0 && col < 120 + int(hash(1, line, seed) % 40);   // word gaps, ragged right
+            if(isGlyph && ly < GH - 2 && lx < GW - 1 && (((g >> 3) >> ((ly * 5 + lx) % 29)) & 1))
+                v = 20 + static_cast<uint8_t>(g >> 24 & 31);
+        }
+        d[0] = d[1] = d[2] = v;
     }
-}
 
-static Image combineRGB(const Image& r, const Image& g, const Image& b){
-    if(r.width!=g.width || r.width!=b.width || r.height!=g.height || r.height!=b.height)
-        throw std::runtime_error("combine size mismatch");
-    Image out;
-    out.width = r.width; out.height = r.height;
-    out.pixels.resize(out.width*out.height*Image::PIXEL_SIZE);
-    for(size_t i=0;i<out.pixels.size(); i+=Image::PIXEL_SIZE){
-        out.pixels[i+2] = r.pixels[i]; // R
-        out.pixels[i+1] = g.pixels[i]; // G
-        out.pixels[i+0] = b.pixels[i]; // B
+    Image make(Kind k, int w, int h, bool topLeft, const Params& p = Params()){
+        if(w <= 0 || h <= 0) throw std::runtime_error("gen: size must be positive");
+        Validate::dims(uint64_t(w), uint64_t(h), "gen");
+        Image img;
+        img.width = static_cast<uint16_t>(w); img.height = static_cast<uint16_t>(h); img.topLeft = topLeft;
+        img.pixels.resize(size_t(w) * h * Image::PIXEL_SIZE);
+        const int cell = std::max(1, p.cell);
+        Parallel::forRange(h, [&](size_t y0, size_t y1){
+            for(int y = int(y0); y < int(y1); ++y){
+                uint8_t* d = img.pixels.data() + img.memRow(y) * w * Image::PIXEL_SIZE;
+                for(int x = 0; x < w; ++x, d += Image::PIXEL_SIZE){
+                    switch(k){
+                    case GRADIENT:
+                        d[0] = static_cast<uint8_t>((uint64_t(x) + y) * 255 / std::max(1, w + h - 2));
+                        d[1] = static_cast<uint8_t>(uint64_t(y) * 255 / std::max(1, h - 1));
+                        d[2] = static_cast<uint8_t>(uint64_t(x) * 255 / std::max(1, w - 1));
+                        break;
+                    case NOISE:{
+                        uint32_t r = hash(x, y, p.seed);
+                        d[0] = static_cast<uint8_t>(r); d[1] = static_cast<uint8_t>(r >> 8); d[2] = static_cast<uint8_t>(r >> 16);
+                        break;
+                    }
+                    case CHECKER:{
+                        const uint8_t v = ((x / cell + y / cell) & 1) ? 230 : 25;
+                        d[0] = d[1] = d[2] = v;
+                        break;
+                    }
+                    case SOLID:
+                        d[0] = p.bgr[0]; d[1] = p.bgr[1]; d[2] = p.bgr[2];
+                        break;
+                    case TEXT:
+                        textPixel(x, y, h, p.seed, d);
+                        break;
+                    }
+                }
+            }
+        });
+        return img;
     }
-    return out;
 }
 
-static Image rotate180(const Image& src){
-    Image out;
-    out.width = src.width; out.height = src.height;
-    out.pixels.resize(src.pixels.size());
-    size_t pix = src.width * src.height;
-    for(size_t p=0; p<pix; ++p){
-        size_t q = pix - 1 - p;
-        out.pixels[p*Image::PIXEL_SIZE+0] = src.pixels[q*Image::PIXEL_SIZE+0];
-        out.pixels[p*Image::PIXEL_SIZE+1] = src.pixels[q*Image::PIXEL_SIZE+1];
-        out.pixels[p*Image::PIXEL_SIZE+2] = src.pixels[q*Image::PIXEL_SIZE+2];
+// -----------------------------------------------------------------------------
+// Benchmarks
+// -----------------------------------------------------------------------------
+namespace Bench {
+    struct Result {
+        std::string name;
+        double      ms     = 0;      // median wall time per run
+        double      mad    = 0;      // median absolute deviation of the run times
+        double      mbps   = 0;      // payload MB/s at the median
+        double      bytes  = 0;      // payload per run
+        Perf::Counts perf;           // per run, averaged over the timed runs (with --perf)
+    };
+
+    inline double median(std::vector<double> v){
+        if(v.empty()) return 0;
+        std::sort(v.begin(), v.end());
+        size_t m = v.size() / 2;
+        return v.size() % 2 ? v[m] : 0.5 * (v[m - 1] + v[m]);
+    }
+
+    // one untimed warm-up, then reps timed runs summarized by median and MAD
+    template<class F>
+    Result run(const std::string& name, size_t bytes, int reps, F fn){
+        fn();
+        std::unique_ptr<Perf::Counters> counters(Perf::enabled ? new Perf::Counters() : nullptr);
+        if(counters) counters->start();
+        std::vector<double> t;
+        for(int r = 0; r < reps; ++r){
+            auto t0 = std::chrono::steady_clock::now();
+            fn();
+            t.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+        }
+        Result res;
+        if(counters){ res.perf = counters->stop(); res.perf /= std::max(reps, 1); }
+        res.name = name;
+        res.bytes = double(bytes);
+        res.ms   = median(t);
+        for(double& v : t) v = std::fabs(v - res.ms);
+        res.mad  = median(t);
+        res.mbps = res.ms > 0 ? bytes / 1e6 / (res.ms / 1e3) : 0;
+        return res;
+    }
+
+    void print(const Result& r){
+        std::printf("  %-30s %10.3f ms +/- %7.3f %10.1f MB/s\n", r.name.c_str(), r.ms, r.mad, r.mbps);
+        if(r.perf.any()) std::printf("  %-30s %s\n", "", Perf::describe(r.perf, r.bytes).c_str());
+    }
+
+    Image synthetic(int w, int h){
+        Image img;
+        img.width = w; img.height = h;
+        img.pixels.resize(size_t(w) * h * Image::PIXEL_SIZE);
+        for(int y = 0; y < h; ++y)
+            for(int x = 0; x < w; ++x){
+                uint8_t* p = img.px(x, y);
+                p[0] = static_cast<uint8_t>(x); p[1] = static_cast<uint8_t>(y); p[2] = static_cast<uint8_t>(x ^ y);
+            }
+        return img;
+    }
+
+    // a saved run: what was measured and under which conditions
+    struct Baseline {
+        int      width = 0, height = 0, reps = 0;
+        unsigned threads = 0;
+        std::vector<Result> results;
+    };
+
+    Baseline runAll(int w, int h, int reps){
+        std::cout << "Benchmark " << w << "x" << h << ", median of " << reps << " runs\n";
+        if(Perf::enabled){
+            Perf::Counters probe;
+            if(!probe.any()) std::cout << "perf: counters unavailable (" << probe.why << "), timing only\n";
+        }
+        Baseline b;
+        b.width = w; b.height = h; b.reps = reps;
+        b.threads = Parallel::threadCount(std::numeric_limits<size_t>::max());
+        auto add = [&](Result r){ print(r); b.results.push_back(r); };
+
+        Image img = synthetic(w, h);
+        Image other = img;
+        for(uint8_t& v : other.pixels) v = static_cast<uint8_t>(v * 5 + 17);
+        const size_t bytes = img.pixels.size();
+        const std::string bl = "bench_bl.tga", tl = "bench_tl.tga";
+        Image flipped = img;
+        flipped.setOrigin(true);
+        TGA::save(img, bl);
+        TGA::save(flipped, tl);
+        add(run("TGA::save",                      bytes, reps, [&]{ TGA::save(img, bl); }));
+        add(run("TGA::load (bottom-left)",        bytes, reps, [&]{ TGA::load(bl); }));
+        add(run("TGA::load (top-left, kept)",     bytes, reps, [&]{ TGA::load(tl); }));
+        add(run("TGA::load (top-left, flipped)",  bytes, reps, [&]{ TGA::load(tl, false); }));
+        std::remove(bl.c_str());
+        std::remove(tl.c_str());
+
+        const char* modes[] = {"add", "subtract", "multiply", "screen", "overlay"};
+        for(int m = Blend::ADD; m <= Blend::OVERLAY; ++m)
+            add(run(std::string("Blend::") + modes[m], bytes, reps, [&]{ Blend::apply(img, other, Blend::Mode(m)); }));
+
+        Image work = img;
+        add(run("addToChannel",  bytes, reps, [&]{ addToChannel(work, 1, 3); }));
+        add(run("scaleChannel",  bytes, reps, [&]{ scaleChannel(work, 2, 1.01f); }));
+        Image r, g, bl2;
+        add(run("splitRGB",      bytes, reps, [&]{ splitRGB(img, r, g, bl2); }));
+        add(run("combineRGB",    bytes, reps, [&]{ combineRGB(r, g, bl2); }));
+        add(run("rotate180",     bytes, reps, [&]{ rotate180(img); }));
+        return b;
+    }
+
+    void saveBaseline(const Baseline& b, const std::string& path){
+        std::ofstream f(path);
+        if(!f) throw std::runtime_error("Can't write baseline: " + path);
+        f << "{\n  \"width\": " << b.width << ", \"height\": " << b.height
+          << ", \"reps\": " << b.reps << ", \"threads\": " << b.threads << ",\n  \"results\": [\n";
+        for(size_t i = 0; i < b.results.size(); ++i){
+            const Result& r = b.results[i];
+            char line[256];
+            std::snprintf(line, sizeof(line), "    {\"name\": \"%s\", \"ms\": %.6f, \"mad\": %.6f, \"mbps\": %.3f}%s\n",
+                          r.name.c_str(), r.ms, r.mad, r.mbps, i + 1 < b.results.size() ? "," : "");
+            f << line;
+        }
+        f << "  ]\n}\n";
+        if(!f) throw std::runtime_error("Write failed: " + path);
+    }
+
+    // reads back what saveBaseline writes: flat "key": number pairs and one results array
+    Baseline loadBaseline(const std::string& path){
+        std::ifstream f(path);
+        if(!f) throw std::runtime_error("Can't open baseline: " + path);
+        const std::string js((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        auto number = [&](size_t from, const std::string& key, size_t to) -> double {
+            size_t k = js.find("\"" + key + "\"", from);
+            if(k == std::string::npos || k >= to) throw std::runtime_error(path + ": missing \"" + key + "\"");
+            size_t c = js.find(':', k);
+            return std::strtod(js.c_str() + c + 1, nullptr);
+        };
+        Baseline b;
+        const size_t arr = js.find("\"results\"");
+        if(arr == std::string::npos) throw std::runtime_error(path + ": not a benchmark baseline");
+        b.width   = static_cast<int>(number(0, "width", arr));
+        b.height  = static_cast<int>(number(0, "height", arr));
+        b.reps    = static_cast<int>(number(0, "reps", arr));
+        b.threads = static_cast<unsigned>(number(0, "threads", arr));
+        for(size_t at = js.find('{', arr); at != std::string::npos; at = js.find('{', at + 1)){
+            const size_t close = js.find('}', at);
+            size_t n = js.find("\"name\"", at);
+            if(close == std::string::npos || n == std::string::npos || n > close) break;
+            size_t q0 = js.find('"', js.find(':', n)) + 1, q1 = js.find('"', q0);
+            Result r;
+            r.name = js.substr(q0, q1 - q0);
+            r.ms   = number(at, "ms", close);
+            r.mad  = number(at, "mad", close);
+            r.mbps = number(at, "mbps", close);
+            b.results.push_back(r);
+        }
+        return b;
+    }
+
+    // an operation regresses when it is slower than baseline by more than thresholdPct
+    // and the slowdown also clears the combined noise (3 x scaled MAD of both runs).
+    // Prints a table to os and returns the number of regressions.
+    size_t compare(const Baseline& base, const Baseline& cur, double thresholdPct, std::ostream& os = std::cout){
+        if(base.threads != cur.threads)
+            os << formatted("note: baseline used %u threads, this run %u\n", base.threads, cur.threads);
+        os << formatted("\n  %-30s %10s %10s %8s  %s\n", "operation", "base ms", "now ms", "change", "status");
+        size_t regressions = 0;
+        for(const Result& c : cur.results){
+            auto it = std::find_if(base.results.begin(), base.results.end(), [&](const Result& r){ return r.name == c.name; });
+            if(it == base.results.end()){
+                os << formatted("  %-30s %10s %10.3f %8s  new\n", c.name.c_str(), "-", c.ms, "");
+                continue;
+            }
+            const double change = it->ms > 0 ? (c.ms - it->ms) / it->ms * 100.0 : 0;
+            const double noise  = 3.0 * 1.4826 * (it->mad + c.mad);
+            const char* status = "ok";
+            if(change > thresholdPct && c.ms - it->ms > noise){ status = "REGRESSED"; ++regressions; }
+            else if(change < -thresholdPct && it->ms - c.ms > noise) status = "faster";
+            os << formatted("  %-30s %10.3f %10.3f %+7.1f%%  %s\n", c.name.c_str(), it->ms, c.ms, change, status);
+        }
+        for(const Result& r : base.results)
+            if(std::none_of(cur.results.begin(), cur.results.end(), [&](const Result& c){ return c.name == r.name; }))
+                os << formatted("  %-30s %10.3f %10s %8s  missing\n", r.name.c_str(), r.ms, "-", "");
+        if(regressions) os << formatted("\n%zu operation(s) regressed by more than %.1f%%\n", regressions, thresholdPct);
+        else            os << formatted("\nno regressions beyond %.1f%%\n", thresholdPct);
+        return regressions;
     }
-    return out;
 }
 
 // -----------------------------------------------------------------------------
@@ -268,13 +3173,114 @@ namespace Tests {
     size_t countDiff(const Image& a, const Image& b){
         if(a.width!=b.width || a.height!=b.height) return std::numeric_limits<size_t>::max();
         size_t d=0;
-        for(size_t i=0;i<a.pixels.size();++i)
-            if(a.pixels[i]!=b.pixels[i]) ++d;
+        ConstImageView av = a.view(), bv = b.view();
+        for(int y=0;y<a.height;++y){
+            const uint8_t *pa = av.row(y), *pb = bv.row(y);
+            for(int i=0;i<a.width*3;++i)
+                if(pa[i]!=pb[i]) ++d;
+        }
         return d;
     }
 
+    // minimal inflate for the blocks PNG::deflateChunk emits (stored and fixed Huffman)
+    std::vector<uint8_t> inflate(const uint8_t* p, size_t n){
+        std::vector<uint8_t> out;
+        size_t bitPos = 0;
+        auto bit = [&]() -> uint32_t {
+            if(bitPos >= n * 8) throw std::runtime_error("TEST FAIL: inflate ran off the end");
+            uint32_t b = (p[bitPos >> 3] >> (bitPos & 7)) & 1; ++bitPos; return b;
+        };
+        auto bits = [&](int count){ uint32_t v = 0; for(int i = 0; i < count; ++i) v |= bit() << i; return v; };
+        auto symbol = [&]() -> int {                     // fixed literal/length code, read MSB first
+            uint32_t code = 0;
+            for(int len = 1; len <= 9; ++len){
+                code = (code << 1) | bit();
+                if(len == 7 && code <= 0x17)                   return 256 + code;
+                if(len == 8 && code >= 0x30 && code <= 0xbf)   return code - 0x30;
+                if(len == 8 && code >= 0xc0 && code <= 0xc7)  return 280 + code - 0xc0;
+                if(len == 9 && code >= 0x190)                  return 144 + code - 0x190;
+            }
+            throw std::runtime_error("TEST FAIL: bad fixed code");
+        };
+        for(bool final = false; !final; ){
+            final = bit();
+            uint32_t type = bits(2);
+            if(type == 0){
+                bitPos = (bitPos + 7) & ~size_t(7);
+                if(bitPos / 8 + 4 > n) throw std::runtime_error("TEST FAIL: stored header truncated");
+                const uint8_t* h = p + bitPos / 8;
+                size_t len = h[0] | (h[1] << 8);
+                if((len ^ 0xffff) != size_t(h[2] | (h[3] << 8)) || bitPos / 8 + 4 + len > n)
+                    throw std::runtime_error("TEST FAIL: bad stored block");
+                out.insert(out.end(), h + 4, h + 4 + len);
+                bitPos += (4 + len) * 8;
+            }else if(type == 1){
+                for(int sym; (sym = symbol()) != 256; ){
+                    if(sym < 256){ out.push_back(static_cast<uint8_t>(sym)); continue; }
+                    int ls = sym - 257;
+                    size_t len = PNG::FixedCodes::LEN_BASE[ls] + bits(PNG::FixedCodes::LEN_EXTRA[ls]);
+                    uint32_t ds = 0;
+                    for(int i = 0; i < 5; ++i) ds = (ds << 1) | bit();
+                    size_t dist = PNG::FixedCodes::DIST_BASE[ds] + bits(PNG::FixedCodes::DIST_EXTRA[ds]);
+                    if(dist > out.size()) throw std::runtime_error("TEST FAIL: distance before start");
+                    for(size_t k = 0; k < len; ++k) out.push_back(out[out.size() - dist]);
+                }
+            }else throw std::runtime_error("TEST FAIL: unexpected block type");
+        }
+        return out;
+    }
+
+    // decode an encoder-produced PNG (8-bit RGB, no interlace) back into a top-left BGR image
+    Image decodePNG(const std::vector<uint8_t>& png){
+        Image img; img.topLeft = true;
+        std::vector<uint8_t> idat;
+        for(size_t pos = 8; pos + 12 <= png.size(); ){
+            size_t len = (size_t(png[pos]) << 24) | (png[pos+1] << 16) | (png[pos+2] << 8) | png[pos+3];
+            const uint8_t* type = png.data() + pos + 4;
+            check(pos + 12 + len <= png.size(), "png chunk length");
+            uint32_t crc = (uint32_t(type[4+len]) << 24) | (type[5+len] << 16) | (type[6+len] << 8) | type[7+len];
+            check(PNG::crc32(type, len + 4) == crc, "png chunk crc");
+            if(!std::memcmp(type, "IHDR", 4)){
+                img.width  = (type[4] << 24) | (type[5] << 16) | (type[6] << 8) | type[7];
+                img.height = (type[8] << 24) | (type[9] << 16) | (type[10] << 8) | type[11];
+            }
+            if(!std::memcmp(type, "IDAT", 4)) idat.insert(idat.end(), type + 4, type + 4 + len);
+            pos += 12 + len;
+        }
+        check(idat.size() > 6 && ((idat[0] << 8) | idat[1]) % 31 == 0, "zlib header");
+        std::vector<uint8_t> raw = inflate(idat.data() + 2, idat.size() - 6);
+        const uint8_t* a = idat.data() + idat.size() - 4;
+        check(PNG::adler32(raw.data(), raw.size()) == ((uint32_t(a[0]) << 24) | (a[1] << 16) | (a[2] << 8) | a[3]), "zlib adler32");
+
+        const size_t rowBytes = img.width * Image::PIXEL_SIZE;
+        check(raw.size() == (rowBytes + 1) * img.height, "png raw size");
+        img.pixels.resize(rowBytes * img.height);
+        std::vector<uint8_t> prev(rowBytes, 0), cur(rowBytes);
+        for(int y = 0; y < img.height; ++y){
+            const uint8_t* line = raw.data() + y * (rowBytes + 1);
+            for(size_t i = 0; i < rowBytes; ++i){
+                int left = i >= 3 ? cur[i - 3] : 0, up = prev[i], ul = i >= 3 ? prev[i - 3] : 0;
+                int pred = 0;
+                switch(line[0]){
+                    case 0: break;
+                    case 1: pred = left; break;
+                    case 2: pred = up; break;
+                    case 3: pred = (left + up) >> 1; break;
+                    case 4: pred = PNG::paeth(left, up, ul); break;
+                    default: check(false, "png filter type");
+                }
+                cur[i] = static_cast<uint8_t>(line[1 + i] + pred);
+            }
+            uint8_t* d = img.pixels.data() + y * rowBytes;
+            for(size_t i = 0; i < rowBytes; i += 3){ d[i] = cur[i+2]; d[i+1] = cur[i+1]; d[i+2] = cur[i]; }
+            prev.swap(cur);
+        }
+        return img;
+    }
+
     void runAll(){
         std::cout << "Running tests...\n";
+        std::ostream quiet(nullptr);      // swallows report tables from the code under test
 
         // 1. px addressing
         {
@@ -306,6 +3312,524 @@ namespace Tests {
             check(l.px(1,1)[0]==128 && l.px(1,1)[1]==128, "gray at (1,1)");
             std::remove("test_2x2.tga");
         }
+        // 5. QOI round-trip (runs, diffs, luma and literal pixels)
+        {
+            Image t; t.width=5; t.height=3; t.pixels.resize(45);
+            for(size_t i=0;i<t.pixels.size();++i) t.pixels[i] = (i < 15) ? 7 : static_cast<uint8_t>(i*37);
+            std::vector<uint8_t> enc = QOI::encode(t);
+            Image d = QOI::decode(enc.data(), enc.size(), "qoi test");
+            check(countDiff(t,d)==0, "qoi round-trip");
+            check(ImageIO::hasExt("x.QOI",".qoi") && !ImageIO::hasExt("x.tga",".qoi"), "qoi ext dispatch");
+        }
+        // 6. PNG checksums and container
+        {
+            const uint8_t digits[] = {'1','2','3','4','5','6','7','8','9'};
+            check(PNG::crc32(digits, 9) == 0xCBF43926u, "crc32");
+            check(PNG::adler32(digits, 9) == 0x091E01DEu, "adler32");
+            Image t; t.width=4; t.height=2; t.pixels.assign(24, 200);
+            PNG::Options o; o.level = 0;
+            std::vector<uint8_t> png = PNG::encode(t, o);
+            check(png.size() > 8 && png[1]=='P' && png[2]=='N' && png[3]=='G', "png signature");
+
+            // pixels survive filtering and deflate at every effort level, across chunk seams
+            Image g; g.width=37; g.height=23; g.pixels.resize(37*23*3);
+            for(size_t i=0;i<g.pixels.size();++i) g.pixels[i] = static_cast<uint8_t>((i % 111 < 60) ? (i / 7) * 13 : i * i % 251);
+            for(int level : {0, 1, 6, 9}) for(size_t chunk : {size_t(256*1024), size_t(97)}){
+                PNG::Options po; po.level = level; po.chunkBytes = chunk;
+                check(countDiff(g, decodePNG(PNG::encode(g, po))) == 0, "png inflate matches source (level " + std::to_string(level) + ")");
+            }
+            // noise falls back to stored blocks instead of growing past level 0
+            Image nz; nz.width=64; nz.height=64; nz.pixels.resize(64*64*3);
+            uint32_t seed = 12345;
+            for(uint8_t& v : nz.pixels){ seed = seed * 1664525u + 1013904223u; v = static_cast<uint8_t>(seed >> 24); }
+            PNG::Options p0, p1; p0.level = 0; p1.level = 1; p0.chunkBytes = p1.chunkBytes = 4096;
+            std::vector<uint8_t> s0 = PNG::encode(nz, p0), s1 = PNG::encode(nz, p1);
+            check(s1.size() <= s0.size() && countDiff(nz, decodePNG(s1)) == 0, "png noise stored fallback");
+        }
+        // 7. pyramid: 2x2 box average, odd edges replicated
+        {
+            Image t; t.width=3; t.height=2; t.pixels.assign(18, 0);
+            t.px(0,0)[0]=10; t.px(1,0)[0]=20; t.px(0,1)[0]=30; t.px(1,1)[0]=40; t.px(2,0)[0]=100; t.px(2,1)[0]=51;
+            Image h = Pyramid::downsample2x(t);
+            check(h.width==2 && h.height==1, "pyramid dims");
+            check(h.px(0,0)[0]==25 && h.px(1,0)[0]==76, "pyramid average");
+            check(Pyramid::build(t, 8).size()==3, "pyramid stops at 1x1");
+            check(ImageIO::withSuffix("out/a.tga","_thumb")=="out/a_thumb.tga", "thumb name");
+        }
+        // 8. resize: flat stays flat, weights keep unit gain at the edges
+        {
+            Image t; t.width=7; t.height=5; t.pixels.assign(105, 90);
+            for(Resample::Filter f : {Resample::NEAREST, Resample::BILINEAR, Resample::LANCZOS3}){
+                Image up = Resample::resize(t, 16, 3, f), dn = Resample::resize(t, 2, 9, f);
+                check(up.width==16 && up.height==3 && dn.width==2 && dn.height==9, "resize dims");
+                check(std::all_of(up.pixels.begin(), up.pixels.end(), [](uint8_t v){ return v==90; }) &&
+                      std::all_of(dn.pixels.begin(), dn.pixels.end(), [](uint8_t v){ return v==90; }), "resize flat");
+            }
+            Image same = Resample::resize(t, 7, 5, Resample::LANCZOS3);
+            check(countDiff(same, t)==0, "resize identity");
+            // one rounding: a checkerboard's Lanczos overshoot must survive the horizontal pass
+            Image cb; cb.width=12; cb.height=10; cb.pixels.resize(360);
+            for(int y=0;y<10;++y) for(int x=0;x<12;++x) std::memset(cb.px(x,y), ((x+y)&1) ? 255 : 0, 3);
+            const int W=29, H=4;
+            Image rs = Resample::resize(cb, W, H, Resample::LANCZOS3);
+            Resample::Weights wx = Resample::makeWeights(12, W, Resample::LANCZOS3), wy = Resample::makeWeights(10, H, Resample::LANCZOS3);
+            int worst = 0;
+            for(int y=0;y<H;++y) for(int x=0;x<W;++x){
+                double v = 0;
+                for(int j=0;j<wy.taps;++j) for(int i=0;i<wx.taps;++i)
+                    v += wy.coef[y*wy.taps+j] * double(wx.coef[x*wx.taps+i]) * cb.px(wx.start[x]+i, wy.start[y]+j)[0];
+                v = std::min(255.0, std::max(0.0, std::round(v / (1 << (2 * Resample::PRECISION)))));
+                worst = std::max(worst, std::abs(rs.px(x,y)[0] - int(v)));
+            }
+            check(worst <= 1, "resize rounds once");
+        }
+        // 9. convolution: box blur matches a direct sum, separable kernel agrees with it
+        {
+            Image t; t.width=9; t.height=6; t.pixels.resize(162);
+            for(size_t i=0;i<t.pixels.size();++i) t.pixels[i] = static_cast<uint8_t>((i*73) & 0xff);
+            Image bb = Convolve::boxBlur(t, 2);
+            Image sp = Convolve::separable(t, std::vector<float>(5, 0.2f));
+            bool ok = true;
+            for(int y=0;y<6;++y) for(int x=0;x<9;++x) for(int c=0;c<3;++c){
+                int sum=0;
+                for(int dy=-2;dy<=2;++dy) for(int dx=-2;dx<=2;++dx)
+                    sum += t.px(Convolve::clampIndex(x+dx,9), Convolve::clampIndex(y+dy,6))[c];
+                ok = ok && bb.px(x,y)[c]==(sum+12)/25 && std::abs(sp.px(x,y)[c]-bb.px(x,y)[c])<=1;
+            }
+            check(ok, "box blur");
+            // asymmetric kernel: output (x, y) is input (x+1, y+1), clamped, whatever the row order
+            Image tt = t; tt.setOrigin(true);
+            const std::vector<float> shift = {0.f, 0.f, 1.f};
+            Image sb = Convolve::separable(t, shift), st = Convolve::separable(tt, shift);
+            ok = st.topLeft && countDiff(sb, st)==0;
+            for(int y=0;y<6;++y) for(int x=0;x<9;++x)
+                ok = ok && std::memcmp(st.px(x,y), t.px(std::min(x+1,8), std::min(y+1,5)), 3)==0;
+            check(ok, "separable asymmetric kernel, top-left");
+            Image white; white.width=4; white.height=3; white.pixels.assign(36, 255);
+            check(countDiff(Convolve::boxBlur(white, 1500), white)==0, "box blur large radius");   // 255*3001^2 > INT32_MAX
+            Image flat; flat.width=5; flat.height=5; flat.pixels.assign(75, 77);
+            check(countDiff(Convolve::unsharp(flat, 1.5, 2.0), flat)==0, "unsharp flat");
+        }
+        // 10. stats
+        {
+            Image t; t.width=4; t.height=1; t.pixels = {0,10,200, 2,10,100, 4,10,0, 6,10,100};
+            Stats::Result r = Stats::compute(t);
+            check(r.pixels==4 && r.ch[0].min==0 && r.ch[0].max==6 && r.ch[0].mean==3.0, "stats B");
+            check(r.ch[1].stddev==0.0 && r.ch[1].hist[10]==4, "stats G");
+            check(r.ch[2].mean==100.0 && std::fabs(r.ch[2].stddev-std::sqrt(5000.0))<1e-9, "stats R");
+        }
+        // 11. auto-levels / equalization LUTs
+        {
+            Image t; t.width=4; t.height=1; t.pixels = {50,0,9, 100,0,9, 150,0,9, 150,255,9};
+            Image a = t; Levels::autoLevels(a);
+            check(a.pixels[0]==0 && a.pixels[3]==128 && a.pixels[9]==255, "autolevels stretch");
+            check(a.pixels[1]==0 && a.pixels[10]==255 && a.pixels[2]==9, "autolevels full/flat channels");
+            Image e = t; Levels::equalize(e);
+            check(e.pixels[0]==0 && e.pixels[3]==85 && e.pixels[6]==255 && e.pixels[9]==255, "equalize");
+        }
+        // 12. color spaces: known values and near-lossless round trips
+        {
+            uint8_t red[3]={0,0,255}, white[3]={255,255,255}, t[3], back[3];
+            check(ColorMath::luma(255,255,255)==255 && ColorMath::luma(0,0,255)==77, "luma");
+            ColorSpace::bgrToHsv(red, t); check(t[0]==0 && t[1]==255 && t[2]==255, "hsv red");
+            ColorSpace::bgrToYcc(white, t); check(t[0]==255 && t[1]==128 && t[2]==128, "ycc white");
+            ColorSpace::bgrToYcc(red, t); check(t[2]==255, "ycc red saturates Cr");
+            ColorSpace::yccToBgr(t, back); check(back[2]>=253 && back[1]<=2 && back[0]<=2, "ycc red round trip");
+            uint8_t blue[3]={255,0,0};
+            ColorSpace::bgrToYcc(blue, t); check(t[1]==255, "ycc blue saturates Cb");
+            ColorSpace::yccToBgr(t, back); check(back[0]>=253 && back[1]<=2 && back[2]<=2, "ycc blue round trip");
+            bool ok = true;
+            for(int v=0; v<4096; ++v){
+                uint8_t p[3]={uint8_t(v*37), uint8_t(v*11+5), uint8_t(v*101)};
+                ColorSpace::bgrToYcc(p,t); ColorSpace::yccToBgr(t,back);
+                for(int c=0;c<3;++c) ok = ok && std::abs(back[c]-p[c])<=2;
+                ColorSpace::bgrToHsv(p,t); ColorSpace::hsvToBgr(t,back);
+                for(int c=0;c<3;++c) ok = ok && std::abs(back[c]-p[c])<=4;
+            }
+            check(ok, "color space round trip");
+            Image g; g.width=2; g.height=1; g.pixels={0,0,255, 10,20,30};
+            TGA::saveGray(g, "test_gray.tga");
+            Image l = TGA::load("test_gray.tga");
+            check(l.px(0,0)[0]==77 && l.px(0,0)[2]==77 && l.px(1,0)[1]==ColorMath::luma(10,20,30), "gray tga");
+            std::remove("test_gray.tga");
+        }
+        // 13. linear-light blending
+        {
+            bool ok = true;
+            for(int v=0; v<256; ++v) ok = ok && Blend::linear_to_srgb[Blend::srgb_to_linear[v] >> Blend::LINEAR_INDEX_SHIFT]==v;
+            check(ok, "srgb table round trip");
+            Image a; a.width=1; a.height=1; a.pixels={188,255,0};
+            Image b; b.width=1; b.height=1; b.pixels={188,128,77};
+            Image m = Blend::apply(a, b, Blend::MULTIPLY, true);
+            check(std::abs(m.pixels[0]-137)<=1 && m.pixels[1]==128 && m.pixels[2]==0, "linear multiply");
+        }
+        // 14. 16-bit pipeline: promotion is exact, chains round once
+        {
+            Image a; a.width=1; a.height=1; a.pixels={255,128,3};
+            Image b; b.width=1; b.height=1; b.pixels={101,101,101};
+            check(countDiff(HP::demote(HP::promote(a)), a)==0, "hp round trip");
+            check(countDiff(HP::demote(HP::blend(HP::promote(a), HP::promote(b), Blend::MULTIPLY)), Blend::apply(a, b, Blend::MULTIPLY))==0, "hp multiply");
+            // 61*61*77/255^2 = 4.4: 8-bit rounds twice (15 -> 5), 16-bit only once (4)
+            Image d; d.width=1; d.height=1; d.pixels={61,61,61};
+            Image e; e.width=1; e.height=1; e.pixels={77,77,77};
+            Image16 dd = HP::blend(HP::promote(d), HP::promote(d), Blend::MULTIPLY);
+            check(HP::demote(HP::blend(dd, HP::promote(e), Blend::MULTIPLY)).pixels[0]==4, "hp chain");
+            check(Blend::apply(Blend::apply(d, d, Blend::MULTIPLY), e, Blend::MULTIPLY).pixels[0]==5, "8-bit chain");
+        }
+        // 15. dithering: flat 16-bit input keeps its mean, every mode stays within one step
+        {
+            Image16 g; g.width=64; g.height=48; g.pixels.assign(64*48*3, 100*257 + 100);   // 100.39
+            for(Dither::Mode m : {Dither::BAYER, Dither::BLUE_NOISE, Dither::FLOYD_STEINBERG}){
+                Image q = Dither::quantize(g, m);
+                size_t hi = std::count(q.pixels.begin(), q.pixels.end(), 101);
+                size_t lo = std::count(q.pixels.begin(), q.pixels.end(), 100);
+                check(hi + lo == q.pixels.size(), "dither within one step");
+                check(std::fabs(double(hi) / q.pixels.size() - 100.0 / 257.0) < 0.03, "dither mean");
+            }
+            Image plain = Dither::quantize(g, Dither::NONE);
+            check(std::count(plain.pixels.begin(), plain.pixels.end(), 100) == 64*48*3, "no dither");
+        }
+        // 16. regions: views are zero-copy and ops leave the outside untouched
+        {
+            Image a; a.width=4; a.height=3; a.pixels.assign(36, 100);
+            Image b; b.width=4; b.height=3; b.pixels.assign(36, 50);
+            Rect r{1,1,2,2};
+            ImageView v = a.view(r);
+            check(v.data == a.px(1,1) && v.stride == 12, "view is zero-copy");
+            Blend::applyRegion(a, b, r, Blend::ADD);
+            check(a.px(1,1)[0]==150 && a.px(2,2)[2]==150 && a.px(0,0)[0]==100 && a.px(3,2)[0]==100, "blend region");
+            addToChannel(a.view(Rect{0,0,1,3}), 2, 5);
+            check(a.px(0,2)[2]==105 && a.px(0,2)[0]==100 && a.px(1,1)[2]==150, "addch region");
+            Image c = copyView(a.view(r));
+            check(c.width==2 && c.height==2 && c.px(0,0)[0]==150, "crop");
+            bool threw = false;
+            try{ a.view(Rect{3,0,2,1}); }catch(const std::runtime_error&){ threw = true; }
+            check(threw, "region bounds");
+            for(Rect o : {Rect{2147483647,0,1,1}, Rect{0,2147483000,1,1000}, Rect{1,0,2147483647,1}}){
+                threw = false;
+                try{ a.view(o); }catch(const std::runtime_error&){ threw = true; }
+                check(threw, "region bounds overflow");
+            }
+        }
+        // 17. offset placement touches only the overlap, clipped at the edges
+        {
+            Image a; a.width=5; a.height=4; a.pixels.assign(60, 10);
+            Image logo; logo.width=2; logo.height=2; logo.pixels.assign(12, 5);
+            Blend::applyAt(a, logo, 4, -1, Blend::ADD);
+            check(a.px(4,0)[0]==15 && a.px(3,0)[0]==10 && a.px(4,1)[0]==10, "applyAt clipped corner");
+            Image before = a;
+            Blend::applyAt(a, logo, std::numeric_limits<int>::max() - 1, std::numeric_limits<int>::max(), Blend::ADD);
+            Blend::applyAt(a, logo, std::numeric_limits<int>::min(), 0, Blend::ADD);
+            check(countDiff(a, before)==0, "applyAt extreme offsets");
+            Blend::applyAt(a, logo, 1, 1, Blend::SUBTRACT);
+            check(a.px(1,1)[1]==5 && a.px(2,2)[2]==5 && a.px(3,3)[0]==10, "applyAt interior");
+            Blend::applyAt(a, logo, 9, 9, Blend::ADD);   // no overlap, no-op
+        }
+        // 18. tiled overlay equals blending against the materialized repeat; padding
+        {
+            Image base; base.width=7; base.height=5; base.pixels.resize(105);
+            for(size_t i=0;i<base.pixels.size();++i) base.pixels[i] = static_cast<uint8_t>(i*29);
+            Image tile; tile.width=3; tile.height=2; tile.pixels.resize(18);
+            for(size_t i=0;i<tile.pixels.size();++i) tile.pixels[i] = static_cast<uint8_t>(i*53+7);
+            Image full; full.width=7; full.height=5; full.pixels.resize(105);
+            for(int y=0;y<5;++y) for(int x=0;x<7;++x) std::memcpy(full.px(x,y), tile.px(x%3, y%2), 3);
+            check(countDiff(Blend::applyTiled(base, tile, Blend::SCREEN), Blend::apply(base, full, Blend::SCREEN))==0, "tiled blend");
+            const uint8_t red[3] = {0,0,255};
+            Image p = Canvas::pad(tile, 1, 2, 0, 1, red);
+            check(p.width==4 && p.height==5 && p.px(0,0)[2]==255 && p.px(3,4)[2]==255, "pad fill");
+            check(std::memcmp(p.px(1,2), tile.px(0,0), 3)==0 && std::memcmp(p.px(3,3), tile.px(2,1), 3)==0, "pad copy");
+        }
+        // 19. top-left files load either flipped into bottom-left memory or kept as stored
+        {
+            Image t = Bench::synthetic(5, 4);
+            Image tl = t; tl.setOrigin(true);
+            check(tl.px(1,3)[2]==t.px(1,3)[2] && tl.pixels[2]==t.px(0,3)[2], "setOrigin keeps coordinates");
+            TGA::save(tl, "test_tl.tga");
+            Image flipped = TGA::load("test_tl.tga", false);
+            check(!flipped.topLeft && flipped.pixels==t.pixels, "top-left load flipped");
+            Image kept = TGA::load("test_tl.tga");
+            check(kept.topLeft && kept.pixels==tl.pixels && countDiff(kept, t)==0, "top-left load kept");
+            std::remove("test_tl.tga");
+        }
+        // 20. mixed storage orders through blend, crop, pad, QOI
+        {
+            Image a = Bench::synthetic(6, 5), b = Bench::synthetic(6, 5);
+            for(uint8_t& v : b.pixels) v = static_cast<uint8_t>(v * 7 + 3);
+            Image ref = Blend::apply(a, b, Blend::SCREEN);
+            Image bt = b; bt.setOrigin(true);
+            Image mixed = Blend::apply(a, bt, Blend::SCREEN);
+            check(!mixed.topLeft && countDiff(mixed, ref)==0, "blend mixed origins");
+            Image at = a; at.setOrigin(true);
+            Image both = Blend::apply(at, bt, Blend::SCREEN);
+            check(both.topLeft && countDiff(both, ref)==0, "blend top-left pair");
+            check(countDiff(copyView(at.view(Rect{1,2,3,2})), copyView(a.view(Rect{1,2,3,2})))==0, "crop top-left");
+            const uint8_t k[3] = {1,2,3};
+            check(countDiff(Canvas::pad(at,1,2,0,1,k), Canvas::pad(a,1,2,0,1,k))==0, "pad top-left");
+            std::vector<uint8_t> q = QOI::encode(at);
+            check(q == QOI::encode(a) && countDiff(QOI::decode(q.data(), q.size(), "qoi"), a)==0, "qoi origins");
+            check(countDiff(Pyramid::downsample2x(at), Pyramid::downsample2x(a))==0, "pyramid odd height, top-left");
+            Image sq = Bench::synthetic(4, 4), sqt = sq; sqt.setOrigin(true);
+            for(Resample::Filter f : {Resample::NEAREST, Resample::BILINEAR, Resample::LANCZOS3})
+                check(countDiff(Resample::resize(sqt, 4, 2, f), Resample::resize(sq, 4, 2, f))==0, "resize top-left");
+        }
+        // 21. malformed headers fail before allocating
+        {
+            auto throws = [](auto fn){ try{ fn(); }catch(const std::runtime_error&){ return true; } return false; };
+            TGA::save(Bench::synthetic(8, 6), "test_bad.tga");
+            std::vector<char> f;
+            { std::ifstream in("test_bad.tga", std::ios::binary); f.assign(std::istreambuf_iterator<char>(in), {}); }
+            auto write = [&](size_t n){ std::ofstream("test_bad.tga", std::ios::binary).write(f.data(), n); };
+            write(f.size() - 1);
+            check(throws([]{ TGA::load("test_bad.tga"); }), "truncated TGA");
+            write(10);
+            check(throws([]{ TGA::load("test_bad.tga"); }), "short TGA header");
+            f[12] = f[13] = f[14] = f[15] = char(0xff);          // claim 65535 x 65535
+            write(f.size());
+            check(throws([]{ TGA::load("test_bad.tga"); }), "oversized TGA");
+            std::remove("test_bad.tga");
+
+            std::vector<uint8_t> q = QOI::encode(Bench::synthetic(8, 6));
+            for(int i : {4, 8}){ q[i] = 0; q[i+1] = 0; q[i+2] = 0x0f; q[i+3] = 0xa0; }   // 4000x4000 from a tiny stream
+            std::string why;
+            try{ QOI::decode(q.data(), q.size(), "qoi"); }catch(const std::runtime_error& e){ why = e.what(); }
+            check(why.find("truncated") != std::string::npos, "QOI size vs dimensions");
+
+            Validate::Limits saved = Validate::limits;
+            Validate::limits.maxDim = 7;
+            check(throws([]{ Image i = Bench::synthetic(8, 6); std::vector<uint8_t> e = QOI::encode(i);
+                             QOI::decode(e.data(), e.size(), "qoi"); }), "max-dim limit");
+            Validate::limits = saved;
+        }
+        // 22. sequence patterns and the load / process / save pipeline
+        {
+            check(Sequence::format("f_%04d.tga", 7)=="f_0007.tga" && Sequence::format("%d%%", 12)=="12%", "sequence format");
+            Sequence::Range r = Sequence::parseRange("3-9");
+            check(r.first==3 && r.last==9 && r.size()==7 && Sequence::parseRange("5").size()==1, "frame range");
+            Image over = Bench::synthetic(4, 3);
+            std::vector<int> order;
+            std::vector<Image> outs;
+            Sequence::run(r,
+                [&](int f){ Image i = Bench::synthetic(4, 3); i.pixels[0] = static_cast<uint8_t>(f); return i; },
+                [&](int, Image& i){ return Blend::apply(i, over, Blend::MULTIPLY); },
+                [&](int f, const Image& o){ order.push_back(f); outs.push_back(o); }, 1);
+            check(order.size()==7 && order.front()==3 && order.back()==9 && std::is_sorted(order.begin(), order.end()), "pipeline order");
+            Image b5 = Bench::synthetic(4, 3); b5.pixels[0] = 5;
+            check(countDiff(outs[2], Blend::apply(b5, over, Blend::MULTIPLY))==0, "pipeline result");
+            bool threw = false;
+            try{
+                Sequence::run(Sequence::Range{0, 50}, [](int f){ return f; },
+                    [](int f, int&){ if(f == 4) throw std::runtime_error("frame 4"); return f; }, [](int, const int&){});
+            }catch(const std::runtime_error& e){ threw = std::string(e.what())=="frame 4"; }
+            check(threw, "pipeline error propagates");
+        }
+        // 23. sliding-window temporal mean / difference match brute force
+        {
+            std::vector<Image> fr;
+            for(int f = 0; f < 5; ++f){
+                Image i = Bench::synthetic(5, 3);
+                for(uint8_t& v : i.pixels) v = static_cast<uint8_t>(v * (f + 1) + f * 31);
+                if(f == 2) i.setOrigin(true);
+                fr.push_back(i);
+            }
+            Temporal::Window win(3);
+            for(int f = 0; f < 5; ++f){
+                Image d = win.diff(fr[f]);
+                win.push(fr[f]);
+                Image m = win.mean();
+                int lo = std::max(0, f - 2);
+                bool ok = true, dok = true;
+                for(int y = 0; y < 3; ++y) for(int x = 0; x < 5; ++x) for(int c = 0; c < 3; ++c){
+                    int s = 0;
+                    for(int k = lo; k <= f; ++k) s += fr[k].px(x, y)[c];
+                    ok &= m.px(x, y)[c] == (s + (f - lo + 1) / 2) / (f - lo + 1);
+                    if(f == 3){
+                        int p = 0; for(int k = 0; k < 3; ++k) p += fr[k].px(x, y)[c];
+                        dok &= d.px(x, y)[c] == std::abs(fr[3].px(x, y)[c] - (p + 1) / 3);
+                    }
+                }
+                check(ok, "temporal mean frame " + std::to_string(f));
+                check(dok, "temporal diff frame " + std::to_string(f));
+            }
+        }
+        // 24. worker processes: every item reported once, failures counted, not fatal
+        {
+            size_t failed = Workers::run(6, 3, [](size_t i){ if(i == 4) throw std::runtime_error("item 4"); },
+                                         [](size_t i){ return "item " + std::to_string(i); }, quiet);
+            check(failed == 1, "workers failure count");
+            Workers::Event ev = Workers::parseEvent("F 7 1.500 4096 512 bad input");
+            check(ev.kind=='F' && ev.item==7 && ev.ms==1.5 && ev.peak==4096 && ev.retained==512 && ev.text=="bad input", "workers event parse");
+            {   // stage rows recorded in worker processes reach the parent's --mem-report table
+                std::lock_guard<std::mutex> lk(Memory::stageLock);
+                Memory::stages.clear();
+            }
+            Memory::report = true;
+            Workers::run(3, 2, [](size_t){ Image i = Bench::synthetic(64, 64); }, [](size_t i){ return "item " + std::to_string(i); }, quiet);
+            Memory::report = false;
+            check(Memory::stages.size() == 3 &&
+                  std::all_of(Memory::stages.begin(), Memory::stages.end(), [](const Memory::StageResult& r){ return r.peak >= 64 * 64 * 3; }),
+                  "workers relay stage rows");
+            Memory::stages.clear();
+#ifndef _WIN32
+            // a worker killed mid-item under a budget must not strand its reservation
+            const uint64_t savedBudget = Memory::budget;
+            Memory::budget = 1;
+            failed = Workers::run(4, 2, [](size_t i){ if(i == 0) raise(SIGKILL); },
+                                  [](size_t i){ return "item " + std::to_string(i); }, quiet);
+            Memory::budget = savedBudget;
+            check(failed == 1, "workers budget survives a killed worker");
+#endif
+        }
+#ifndef _WIN32
+        // 25. shared-memory segments keep pixels and row order; views map the rows directly
+        {
+            const std::string name = "shm:p2_test_" + std::to_string(getpid());
+            Image a = Bench::synthetic(7, 5); a.setOrigin(true);
+            ImageIO::save(a, name);
+            Image b = ImageIO::load(name);
+            check(b.topLeft && b.pixels == a.pixels, "shm round trip");
+            {
+                Shm::Segment seg = Shm::open(name, true);
+                check(seg.header().stride % Shm::ROW_ALIGN == 0 && std::memcmp(seg.view().px(3, 1), a.px(3, 1), 3) == 0, "shm view");
+                seg.view().px(0, 0)[0] = 99;
+            }
+            check(ImageIO::load(name).px(0, 0)[0] == 99, "shm writes through the view");
+            {   // rewriting the live header after open() must not change the validated geometry
+                const Shm::Segment reader = Shm::open(name);
+                Shm::Segment writer = Shm::open(name, true);
+                Shm::Header h = writer.header();
+                h.height = 60000; h.stride = uint64_t(1) << 40;
+                std::memcpy(writer.base, &h, sizeof(h));
+                ConstImageView v = reader.view();
+                check(v.height == 5 && reader.header().stride == writer.header().stride, "shm header read once");
+                std::memcpy(writer.base, &writer.header(), sizeof(h));
+            }
+            Shm::remove(name);
+            bool threw = false;
+            try{ ImageIO::load(name); }catch(const std::runtime_error&){ threw = true; }
+            check(threw, "shm missing segment");
+            {   // a stride that would wrap stride * height must be rejected, not read
+                Shm::Segment seg = Shm::create(name, 1, 2, false);
+                Shm::Header h = seg.header();
+                h.stride = uint64_t(1) << 63;
+                std::memcpy(seg.base, &h, sizeof(h));
+                Shm::publish(seg);
+            }
+            threw = false;
+            try{ ImageIO::load(name); }catch(const std::runtime_error&){ threw = true; }
+            Shm::remove(name);
+            check(threw, "shm hostile stride");
+            {   // a segment is invisible until published; replacing it leaves old mappings intact
+                Shm::Segment seg = Shm::create(name, 2, 2, false);
+                threw = false;
+                try{ ImageIO::load(name); }catch(const std::runtime_error&){ threw = true; }
+                check(threw, "shm unpublished segment");
+                Shm::publish(seg);
+                ImageIO::save(a, name);
+                const Shm::Segment old = Shm::open(name);
+                ImageIO::save(Bench::synthetic(1, 1), name);
+                check(std::memcmp(old.view().px(6, 4), a.px(6, 4), 3) == 0, "shm replace keeps old mapping");
+                check(ImageIO::load(name).width == 1, "shm replace");
+            }
+            Shm::remove(name);
+        }
+#endif
+        // 26. benchmark baselines round-trip through JSON; compare flags only real slowdowns
+        {
+            Bench::Baseline b;
+            b.width = 64; b.height = 32; b.reps = 5; b.threads = 2;
+            auto result = [](const char* name, double ms, double mad){
+                Bench::Result r;
+                r.name = name; r.ms = ms; r.mad = mad;
+                return r;
+            };
+            b.results = {result("Blend::add", 2.0, 0.01), result("rotate180", 1.0, 0.4)};
+            Bench::saveBaseline(b, "test_base.json");
+            Bench::Baseline l = Bench::loadBaseline("test_base.json");
+            std::remove("test_base.json");
+            check(l.width==64 && l.height==32 && l.reps==5 && l.threads==2 && l.results.size()==2 &&
+                  l.results[1].name=="rotate180" && std::fabs(l.results[0].ms - 2.0) < 1e-9, "baseline round trip");
+            Bench::Baseline now = b;
+            now.results[0].ms = 3.0;      // +50%, well above noise
+            now.results[1].ms = 1.5;      // +50%, but within 3 x MAD of a noisy op
+            check(Bench::compare(b, now, 10.0, quiet) == 1, "baseline compare");
+        }
+        // 27. perf counters degrade to "n/a" instead of failing
+        {
+            // counters that opened may still read as invalid if the kernel never scheduled
+            // them (heavy multiplexing), so only "opened, or a reason" is required; whatever
+            // did read must be a real count
+            Perf::Counters pc;
+            pc.start();
+            volatile uint64_t spin = 0;
+            for(int i = 0; i < 1000000; ++i) spin = spin + i;
+            Perf::Counts c = pc.stop();
+            check(pc.any() || !pc.why.empty(), "perf counters open, or say why not");
+            bool sane = true;
+            for(int e = 0; e < Perf::EVENT_COUNT; ++e) sane = sane && (!c.valid[e] || c.value[e] >= 0);
+            check(sane, "perf counters read as counts");
+            Perf::Counts f;
+            f.value[Perf::CYCLES] = 1000; f.value[Perf::INSTRUCTIONS] = 2000;
+            f.valid[Perf::CYCLES] = f.valid[Perf::INSTRUCTIONS] = true;
+            const std::string d = Perf::describe(f, 500);
+            check(d.find("IPC 2.00") != std::string::npos && d.find("0.50 B/cycle") != std::string::npos &&
+                  d.find("cache-misses n/a") != std::string::npos, "perf describe");
+        }
+        // 28. pixel memory accounting, stage peaks, and a budget that still makes progress
+        {
+            const int64_t base = Memory::live();
+            int64_t peak = 0;
+            {
+                Memory::Stage st("test");
+                Image a = Bench::synthetic(100, 10);
+                check(Memory::live() - base == 3000, "memory live bytes");
+                { Image b = a; }
+                peak = st.peakSoFar() - base;
+            }
+            check(Memory::live() == base && peak == 6000, "memory stage peak");
+            const uint64_t savedBudget = Memory::budget;
+            Memory::budget = 1;
+            int saved = 0;
+            Sequence::run(Sequence::Range{0, 4}, [](int){ return Bench::synthetic(16, 16); },
+                          [](int, Image& i){ return rotate180(i); }, [&](int, const Image&){ ++saved; });
+            Memory::budget = savedBudget;
+            check(saved == 5, "memory budget runs one frame at a time");
+
+            // an in-place step adds no bytes, yet a roomy budget must still let frame 1 load
+            // while frame 0 waits to be saved (bounded wait, so a regression fails instead of hanging)
+            Memory::budget = uint64_t(1) << 40;
+            std::mutex m; std::condition_variable cv; int loads = 0; bool overlapped = false;
+            Sequence::run(Sequence::Range{0, 3},
+                          [&](int){ Image i = Bench::synthetic(16, 16); std::lock_guard<std::mutex> lk(m); ++loads; cv.notify_all(); return i; },
+                          [](int, Image& i){ return std::move(i); },
+                          [&](int f, const Image&){
+                              std::unique_lock<std::mutex> lk(m);
+                              if(f == 0) overlapped = cv.wait_for(lk, std::chrono::seconds(2), [&]{ return loads >= 2; });
+                          });
+            Memory::budget = savedBudget;
+            check(overlapped, "memory budget keeps prefetch for in-place steps");
+        }
+        // 29. generated images: deterministic, thread- and origin-independent, codec-realistic
+        {
+            Generate::Params prm; prm.seed = 7;
+            const unsigned threads = Parallel::maxThreads;
+            Parallel::maxThreads = 1;
+            Image one = Generate::make(Generate::NOISE, 97, 61, false, prm);
+            Parallel::maxThreads = 3;
+            Image three = Generate::make(Generate::NOISE, 97, 61, false, prm);
+            Image tl = Generate::make(Generate::NOISE, 97, 61, true, prm);
+            Parallel::maxThreads = threads;
+            check(one.pixels == three.pixels, "gen thread independent");
+            check(tl.topLeft && tl.pixels != one.pixels && countDiff(tl, one) == 0, "gen origin independent");
+            prm.seed = 8;
+            check(Generate::make(Generate::NOISE, 97, 61, false, prm).pixels != one.pixels, "gen seed");
+            const size_t noisy   = QOI::encode(one).size();
+            const size_t checker = QOI::encode(Generate::make(Generate::CHECKER, 97, 61, false)).size();
+            const size_t text    = QOI::encode(Generate::make(Generate::TEXT, 97, 61, false)).size();
+            check(checker * 20 < noisy && text < noisy / 2, "gen run-friendly vs hostile");
+            Generate::Params red; red.bgr[2] = 255;
+            Image solid = Generate::make(Generate::SOLID, 4, 3, true, red);
+            check(solid.px(3, 2)[2] == 255 && solid.px(0, 0)[0] == 0, "gen solid");
+        }
         std::cout << "All tests passed\n";
     }
 }
@@ -321,69 +3845,253 @@ static void ensureOutputDir(){
 #endif
 }
 
+// frame f of an output pattern; only the pipeline's writer thread calls this
+template<class Img>
+static void saveFrame(const std::string& pattern, int f, const Img& img){
+    const std::string path = Sequence::format(pattern, f);
+    ImageIO::save(img, path);
+    std::cout << "Saved: " << path << "\n";
+}
+
 static void usage(const char* p){
     std::cerr << "Usage:\n"
               << "   " << p << "            (runs all 10 tasks)\n"
               << "   " << p << " test\n"
+              << "   " << p << " bench [w h reps]                    (--save-baseline f.json, --compare f.json)\n"
               << "   " << p << " <blend> <base> <overlay> <out>    (add|subtract|multiply|screen|overlay)\n"
               << "   " << p << " addch   <r|g|b> <delta>  <in> <out>\n"
               << "   " << p << " scalech <r|g|b> <factor> <in> <out>\n"
+              << "   " << p << " crop    <x> <y> <w> <h> <in> <out>  (bottom-left origin)\n"
+              << "   " << p << " tavg    <N> <in_%04d> <out_%04d>    (--frames: mean of the last N frames)\n"
+              << "   " << p << " tdiff   <N> <in_%04d> <out_%04d>    (--frames: |frame - mean of the N before it|)\n"
+              << "   " << p << " pad     <l> <b> <r> <t> <in> <out> [RRGGBB]\n"
+              << "   " << p << " gray    <in> <out>                  (.tga out is written as 8-bit grayscale)\n"
               << "   " << p << " split   <in> <out_prefix>\n"
               << "   " << p << " combine <r.tga> <g.tga> <b.tga> <out>\n"
               << "   " << p << " rot180  <in> <out>\n"
+              << "   " << p << " resize  <w> <h> <in> <out> [nearest|bilinear|lanczos]\n"
+              << "   " << p << " blur    <radius> <in> <out>         (box blur)\n"
+              << "   " << p << " gblur   <sigma>  <in> <out>         (Gaussian, 3 box passes)\n"
+              << "   " << p << " sharpen <sigma> <amount> <in> <out> (unsharp mask)\n"
+              << "   " << p << " pyramid <in> <out> [levels]         (writes <out>_1 .. <out>_N, each half the size)\n"
+              << "   " << p << " autolevels <in> <out> [clip%]       (stretch each channel to 0..255)\n"
+              << "   " << p << " equalize   <in> <out>               (per-channel histogram equalization)\n"
+              << "   " << p << " stats   <in> [hist]                 (per-channel min/max/mean/stddev)\n"
+              << "   " << p << " shmrm   <shm:name>                  (remove a shared-memory image)\n"
+              << "   " << p << " gen     <kind> <w> <h> <out> [p]    (gradient|noise|checker|solid|text; p = seed, cell or RRGGBB)\n"
               << "   " << p << " pixdiff <a.tga> <b.tga>\n"
               << "   " << p << " pixdebug <a.tga> <b.tga> <N>\n"
-              << "   " << p << " runall\n";
+              << "   " << p << " runall\n"
+              << "Paths ending in .qoi are read/written as QOI, .png is written as PNG, everything else is TGA.\n"
+              << "shm:<name> reads/writes a POSIX shared-memory segment (64-byte header, then BGR rows).\n"
+              << "Options: --png-level <0-9> (0 = stored, 1 = fast)  --threads <N>\n"
+              << "         --hp (runall/addch/scalech: keep 16 bits per channel until the save; whole rgb images only)\n"
+              << "         --dither <none|bayer|bluenoise|fs> (how 16-bit results are rounded on save)\n"
+              << "         --linear (blend: decode sRGB to linear light, blend, re-encode)\n"
+              << "         --fit <nearest|bilinear|lanczos> (blend: resize overlay to base)\n"
+              << "         --space <rgb|ycc|hsv> (addch/scalech channel space; channels y/cb/cr or h/s/v)\n"
+              << "         --tile (blend: repeat a small overlay tile across the base)\n"
+              << "         --at <x,y> (blend: composite a smaller overlay with its bottom-left corner at x,y; --tile, --at and --roi are exclusive)\n"
+              << "         --roi <x,y,w,h> (blend/addch/scalech: only read and write this region)\n"
+              << "         --frames <a-b> (blend/addch/scalech: in/out paths are patterns like f_%04d.tga;\n"
+              << "                        frames are prefetched and saved while others compute, a\n"
+              << "                        non-pattern overlay is loaded once)\n"
+              << "         --workers <N> (runall/--frames: shard the work over N processes, progress and\n"
+              << "                        per-worker timings are reported by the parent)\n"
+              << "         --save-baseline <f.json>  --compare <f.json>  --threshold <pct, default 10>\n"
+              << "                       (bench: record per-operation medians, or fail when any op is slower\n"
+              << "                        than the baseline by more than pct and more than the run-to-run noise)\n"
+              << "         --perf (hardware counters via perf_event_open: IPC, bytes/cycle, cache and\n"
+              << "                 branch misses per bench op, or totals for any other command)\n"
+              << "         --top-left (gen: store rows top-down, as the TGA origin flag says)\n"
+              << "         --mem-report (pixel-buffer peak per stage and per run, plus peak RSS;\n"
+              << "                       --workers items come back as stages, with the largest worker)\n"
+              << "         --mem-budget <MB> (--frames / --workers: defer loading frames or starting items\n"
+              << "                            until their measured peak fits; one always runs)\n"
+              << "         --stats (print channel statistics for every saved image)\n"
+              << "         --thumbs <N> (every save also writes <name>_thumb, downsampled N times)\n"
+              << "         --max-dim <N>  --max-pixels <N> (reject larger inputs before decoding)\n";
+}
+
+// global --options are stripped from argv so the positional checks stay simple
+struct CliOptions {
+    int      pngLevel = 1;
+    unsigned threads  = 0;
+    int      thumbs   = 0;
+    std::string fit;              // blend: resize overlay to base with this filter
+    bool     stats    = false;
+    std::string space = "rgb";    // addch/scalech: channel space (rgb|ycc|hsv)
+    bool     linear   = false;    // blend: gamma-correct (linear-light) math
+    bool     hp       = false;    // runall/addch/scalech: 16-bit intermediates
+    std::string dither = "none";  // how 16-bit results are rounded on save
+    bool     hasRoi   = false;    // blend/addch/scalech: only touch this region
+    Rect     roi;
+    bool     tile     = false;    // blend: overlay is a tile repeated across the base
+    bool     hasAt    = false;    // blend: place the overlay at this offset, in place
+    int      atX = 0, atY = 0;
+    Validate::Limits limits;      // input size limits checked before decoding
+    bool     hasFrames = false;   // blend/addch/scalech: paths are %04d patterns over this range
+    Sequence::Range frames;
+    unsigned workers  = 0;        // runall/--frames: spread the work over this many processes
+    std::string saveBaseline;     // bench: write results as a JSON baseline
+    std::string compare;          // bench: check against this baseline, exit 1 on regressions
+    double   threshold = 10.0;    // bench --compare: allowed slowdown in percent
+    bool     perf     = false;    // hardware counters per bench op, or for the whole command
+    bool     memReport = false;   // print pixel-memory peaks per stage and for the run
+    bool     topLeft  = false;    // gen: store rows top-down
+    uint64_t memBudget = 0;       // bytes; sequence and worker scheduling stay under it
+};
+
+// "x,y,w,h"
+static Rect parseRect(const std::string& s){
+    Rect r;
+    if(std::sscanf(s.c_str(), "%d,%d,%d,%d", &r.x, &r.y, &r.w, &r.h) != 4)
+        throw std::runtime_error("bad region '" + s + "' (want x,y,w,h)");
+    return r;
+}
+
+static CliOptions parseOptions(int& argc, char* argv[]){
+    CliOptions o;
+    int kept = 1;
+    for(int i = 1; i < argc; ++i){
+        std::string a = argv[i];
+        auto value = [&]() -> std::string {
+            if(i + 1 >= argc) throw std::runtime_error(a + " needs a value");
+            return argv[++i];
+        };
+        if(a == "--png-level"){
+            o.pngLevel = std::stoi(value());
+            if(o.pngLevel < 0 || o.pngLevel > 9) throw std::runtime_error("--png-level must be 0-9");
+        }
+        else if(a == "--threads") o.threads  = static_cast<unsigned>(std::stoul(value()));
+        else if(a == "--thumbs")  o.thumbs   = std::stoi(value());
+        else if(a == "--fit")     o.fit      = value();
+        else if(a == "--stats")   o.stats    = true;
+        else if(a == "--space")   o.space    = value();
+        else if(a == "--linear")  o.linear   = true;
+        else if(a == "--hp")      o.hp       = true;
+        else if(a == "--dither")  o.dither   = value();
+        else if(a == "--tile")    o.tile     = true;
+        else if(a == "--max-dim")    o.limits.maxDim    = static_cast<uint32_t>(std::stoul(value()));
+        else if(a == "--max-pixels") o.limits.maxPixels = std::stoull(value());
+        else if(a == "--roi")     { o.roi = parseRect(value()); o.hasRoi = true; }
+        else if(a == "--frames")  { o.frames = Sequence::parseRange(value()); o.hasFrames = true; }
+        else if(a == "--workers") o.workers  = static_cast<unsigned>(std::stoul(value()));
+        else if(a == "--save-baseline") o.saveBaseline = value();
+        else if(a == "--compare")       o.compare      = value();
+        else if(a == "--threshold")     o.threshold    = std::stod(value());
+        else if(a == "--perf")    o.perf     = true;
+        else if(a == "--mem-report") o.memReport = true;
+        else if(a == "--top-left")   o.topLeft   = true;
+        else if(a == "--mem-budget") o.memBudget = std::stoull(value()) * 1024 * 1024;
+        else if(a == "--at"){
+            std::string v = value();
+            if(std::sscanf(v.c_str(), "%d,%d", &o.atX, &o.atY) != 2) throw std::runtime_error("bad offset '" + v + "' (want x,y)");
+            o.hasAt = true;
+        }
+        else argv[kept++] = argv[i];
+    }
+    argc = kept;
+    return o;
+}
+
+// --workers: worker processes pull chunks of the frame range from a shared queue;
+// anything loaded before this call (a constant overlay) is shared copy-on-write
+template<class F>
+static void forFrames(const CliOptions& opt, F runRange){
+    if(opt.workers <= 1){
+        Memory::Stage stage("frames " + std::to_string(opt.frames.first) + "-" + std::to_string(opt.frames.last));
+        runRange(opt.frames);
+        return;
+    }
+    const int    first  = opt.frames.first;
+    const size_t chunk  = std::max<size_t>(1, opt.frames.size() / (size_t(opt.workers) * 4));
+    const size_t chunks = (opt.frames.size() + chunk - 1) / chunk;
+    auto range = [&](size_t c){
+        Sequence::Range r;
+        r.first = first + static_cast<int>(c * chunk);
+        r.last  = std::min(opt.frames.last, r.first + static_cast<int>(chunk) - 1);
+        return r;
+    };
+    size_t failed = Workers::run(chunks, opt.workers, [&](size_t c){ runRange(range(c)); },
+        [&](size_t c){ Sequence::Range r = range(c); return "frames " + std::to_string(r.first) + "-" + std::to_string(r.last); });
+    if(failed) throw std::runtime_error(std::to_string(failed) + " of " + std::to_string(chunks) + " frame chunks failed");
 }
 
 enum { CH_B=0, CH_G=1, CH_R=2 };
 static int chanIndex(char c){ return (c=='b'||c=='B')?CH_B : (c=='g'||c=='G')?CH_G : CH_R; }
 
-// run all assignment parts
-static void doRunAll(){
-    ensureOutputDir();
-    // 1
-    TGA::save( Blend::apply(TGA::load("input/layer1.tga"), TGA::load("input/pattern1.tga"), Blend::MULTIPLY), "output/part1.tga" );
-    // 2
-    TGA::save( Blend::apply(TGA::load("input/car.tga"), TGA::load("input/layer2.tga"), Blend::SUBTRACT), "output/part2.tga" );
-    // 3
-    {
-        Image tmp = Blend::apply(TGA::load("input/layer1.tga"), TGA::load("input/pattern2.tga"), Blend::MULTIPLY);
-        TGA::save( Blend::apply(TGA::load("input/text.tga"), tmp, Blend::SCREEN), "output/part3.tga" );
-    }
-    // 4
-    {
-        Image tmp = Blend::apply(TGA::load("input/layer2.tga"), TGA::load("input/circles.tga"), Blend::MULTIPLY);
-        TGA::save( Blend::apply(tmp, TGA::load("input/pattern2.tga"), Blend::SUBTRACT), "output/part4.tga" );
-    }
-    // 5
-    TGA::save( Blend::apply(TGA::load("input/pattern1.tga"), TGA::load("input/layer1.tga"), Blend::OVERLAY),  "output/part5.tga" );
-    // 6
-    {
-        Image img = TGA::load("input/car.tga"); addToChannel(img, CH_G, 200); TGA::save(img, "output/part6.tga");
-    }
-    // 7
-    {
-        Image img = TGA::load("input/car.tga"); scaleChannel(img, CH_R, 4.0f); scaleChannel(img, CH_B, 0.0f); TGA::save(img, "output/part7.tga");
-    }
-    // 8
-    {
-        Image src = TGA::load("input/car.tga"); Image r,g,b; splitRGB(src,r,g,b);
-        TGA::save(r, "output/part8_r.tga"); TGA::save(g, "output/part8_g.tga"); TGA::save(b, "output/part8_b.tga");
-    }
-    // 9
-    {
-        Image r = TGA::load("input/layer_red.tga");
-        Image g = TGA::load("input/layer_green.tga");
-        Image b = TGA::load("input/layer_blue.tga");
+// one assignment part (1..10)
+// hp: chained parts (3, 4) keep 16 bits per channel between steps
+static void runPart(int part, bool hp){
+    Memory::Stage stage("part " + std::to_string(part));
+    switch(part){
+    case 1:
+        ImageIO::save( Blend::apply(ImageIO::load("input/layer1.tga"), ImageIO::load("input/pattern1.tga"), Blend::MULTIPLY), "output/part1.tga" );
+        break;
+    case 2:
+        ImageIO::save( Blend::apply(ImageIO::load("input/car.tga"), ImageIO::load("input/layer2.tga"), Blend::SUBTRACT), "output/part2.tga" );
+        break;
+    case 3:
+        if(hp){
+            Image16 tmp = HP::blend(HP::promote(ImageIO::load("input/layer1.tga")), HP::promote(ImageIO::load("input/pattern2.tga")), Blend::MULTIPLY);
+            ImageIO::save( HP::blend(HP::promote(ImageIO::load("input/text.tga")), tmp, Blend::SCREEN), "output/part3.tga" );
+        }else{
+            Image tmp = Blend::apply(ImageIO::load("input/layer1.tga"), ImageIO::load("input/pattern2.tga"), Blend::MULTIPLY);
+            ImageIO::save( Blend::apply(ImageIO::load("input/text.tga"), tmp, Blend::SCREEN), "output/part3.tga" );
+        }
+        break;
+    case 4:
+        if(hp){
+            Image16 tmp = HP::blend(HP::promote(ImageIO::load("input/layer2.tga")), HP::promote(ImageIO::load("input/circles.tga")), Blend::MULTIPLY);
+            ImageIO::save( HP::blend(tmp, HP::promote(ImageIO::load("input/pattern2.tga")), Blend::SUBTRACT), "output/part4.tga" );
+        }else{
+            Image tmp = Blend::apply(ImageIO::load("input/layer2.tga"), ImageIO::load("input/circles.tga"), Blend::MULTIPLY);
+            ImageIO::save( Blend::apply(tmp, ImageIO::load("input/pattern2.tga"), Blend::SUBTRACT), "output/part4.tga" );
+        }
+        break;
+    case 5:
+        ImageIO::save( Blend::apply(ImageIO::load("input/pattern1.tga"), ImageIO::load("input/layer1.tga"), Blend::OVERLAY),  "output/part5.tga" );
+        break;
+    case 6:{
+        Image img = ImageIO::load("input/car.tga"); addToChannel(img, CH_G, 200); ImageIO::save(img, "output/part6.tga");
+        break;
+    }
+    case 7:{
+        Image img = ImageIO::load("input/car.tga"); scaleChannel(img, CH_R, 4.0f); scaleChannel(img, CH_B, 0.0f); ImageIO::save(img, "output/part7.tga");
+        break;
+    }
+    case 8:{
+        Image src = ImageIO::load("input/car.tga"); Image r,g,b; splitRGB(src,r,g,b);
+        ImageIO::save(r, "output/part8_r.tga"); ImageIO::save(g, "output/part8_g.tga"); ImageIO::save(b, "output/part8_b.tga");
+        break;
+    }
+    case 9:{
+        Image r = ImageIO::load("input/layer_red.tga");
+        Image g = ImageIO::load("input/layer_green.tga");
+        Image b = ImageIO::load("input/layer_blue.tga");
         Image out = combineRGB(r,g,b);
-        TGA::save(out, "output/part9.tga");
+        ImageIO::save(out, "output/part9.tga");
+        break;
     }
-    // 10
-    {
-        Image t2 = TGA::load("input/text2.tga");
+    case 10:{
+        Image t2 = ImageIO::load("input/text2.tga");
         Image r180 = rotate180(t2);
-        TGA::save(r180, "output/part10.tga");
+        ImageIO::save(r180, "output/part10.tga");
+        break;
+    }
+    }
+}
+
+// run all assignment parts; workers > 1 spreads them over that many processes
+static void doRunAll(bool hp = false, unsigned workers = 0){
+    ensureOutputDir();
+    if(workers > 1){
+        size_t failed = Workers::run(10, workers, [&](size_t i){ runPart(static_cast<int>(i) + 1, hp); },
+                                     [](size_t i){ return "part " + std::to_string(i + 1); });
+        if(failed) throw std::runtime_error(std::to_string(failed) + " of 10 parts failed");
+    }else{
+        for(int part = 1; part <= 10; ++part) runPart(part, hp);
     }
     std::cout << "All parts generated in ./output\n";
 }
@@ -393,19 +4101,55 @@ static void doRunAll(){
 // -----------------------------------------------------------------------------
 int main(int argc, char* argv[]){
     try{
+        CliOptions opt = parseOptions(argc, argv);
+        Parallel::maxThreads        = opt.threads;
+        ImageIO::pngOptions.level   = opt.pngLevel;
+        ImageIO::thumbLevels        = opt.thumbs;
+        ImageIO::printStats         = opt.stats;
+        ImageIO::ditherMode         = Dither::parse(opt.dither);
+        Validate::limits            = opt.limits;
+        Perf::enabled               = opt.perf;
+        Memory::budget              = opt.memBudget;
+        Memory::Scope memScope(opt.memReport);
+        Perf::Scope perfScope(opt.perf && !(argc >= 2 && std::string(argv[1]) == "bench"));
+
         if(argc < 2){
-            doRunAll();
+            doRunAll(opt.hp, opt.workers);
             return 0;
         }
         std::string cmd = argv[1];
 
         if(cmd == "test"){    Tests::runAll(); return 0; }
-        if(cmd == "runall"){  doRunAll();      return 0; }
+        if(cmd == "bench"){
+            if(argc != 2 && argc != 5){ usage(argv[0]); return 1; }
+            int w = 2048, h = 2048, reps = 9;
+            Bench::Baseline base;
+            if(!opt.compare.empty()){
+                base = Bench::loadBaseline(opt.compare);
+                w = base.width; h = base.height; reps = base.reps;      // measure like the baseline did
+            }
+            if(argc == 5){ w = std::stoi(argv[2]); h = std::stoi(argv[3]); reps = std::stoi(argv[4]); }
+            Bench::Baseline cur = Bench::runAll(w, h, reps);
+            if(!opt.saveBaseline.empty()) Bench::saveBaseline(cur, opt.saveBaseline);
+            if(!opt.compare.empty()){
+                if(base.width != w || base.height != h) std::cout << "note: baseline was measured at " << base.width << "x" << base.height << "\n";
+                return Bench::compare(base, cur, opt.threshold) ? 1 : 0;
+            }
+            return 0;
+        }
+        if(cmd == "runall"){  doRunAll(opt.hp, opt.workers); return 0; }
+
+        if(cmd == "stats"){
+            if(argc != 3 && !(argc == 4 && std::string(argv[3]) == "hist")){ usage(argv[0]); return 1; }
+            Image img = ImageIO::load(argv[2]);
+            Stats::print(std::cout, Stats::compute(img), argv[2], argc == 4);
+            return 0;
+        }
 
         if(cmd == "pixdiff"){
             if(argc != 4){ usage(argv[0]); return 1; }
-            Image A = TGA::load(argv[2]);
-            Image B = TGA::load(argv[3]);
+            Image A = ImageIO::load(argv[2]);
+            Image B = ImageIO::load(argv[3]);
             size_t d = Tests::countDiff(A,B);
             if(d==0) std::cout << "MATCH\n"; else std::cout << "DIFFS=" << d << "\n";
             return 0;
@@ -414,8 +4158,9 @@ int main(int argc, char* argv[]){
         if(cmd == "pixdebug"){
             if(argc != 5){ usage(argv[0]); return 1; }
             int maxN = std::stoi(argv[4]);
-            Image A = TGA::load(argv[2]);
-            Image B = TGA::load(argv[3]);
+            Image A = ImageIO::load(argv[2]);
+            Image B = ImageIO::load(argv[3]);
+            A.setOrigin(false); B.setOrigin(false);     // report bottom-left coordinates
             if(A.width!=B.width || A.height!=B.height){
                 std::cout << "Size mismatch: A (" << A.width << "x" << A.height << ") vs B (" << B.width << "x" << B.height << ")\n";
                 return 1;
@@ -446,62 +4191,286 @@ int main(int argc, char* argv[]){
                             (cmd=="multiply")?Blend::MULTIPLY:
                             (cmd=="screen")?Blend::SCREEN:
                                              Blend::OVERLAY;
+            // placement options are exclusive; --fit resizes to the base, so it only pairs with --roi
+            const bool fit = !opt.fit.empty();
+            auto exclusive = [&](bool a, const char* an, bool b, const char* bn){
+                if(a && b) throw std::runtime_error(cmd + ": " + an + " and " + bn + " can't be combined");
+            };
+            exclusive(opt.tile,  "--tile", opt.hasAt,  "--at");
+            exclusive(opt.tile,  "--tile", opt.hasRoi, "--roi");
+            exclusive(opt.hasAt, "--at",   opt.hasRoi, "--roi");
+            exclusive(fit, "--fit", opt.tile,  "--tile");
+            exclusive(fit, "--fit", opt.hasAt, "--at");
+            if(opt.hp) throw std::runtime_error(cmd + ": --hp is not supported for blends (runall/addch/scalech only)");
+            // base may be consumed (in-place modes); the overlay is never modified
+            auto blendFrame = [&](Image& base, const Image& over) -> Image {
+                if(opt.tile) return Blend::applyTiled(base, over, m, opt.linear);
+                if(opt.hasAt){  Blend::applyAt(base, over, opt.atX, opt.atY, m, opt.linear); return std::move(base); }
+                if(opt.hasRoi){ Blend::applyRegion(base, over, opt.roi, m, opt.linear);      return std::move(base); }
+                return Blend::apply(base, over, m, opt.linear);
+            };
+            auto fitTo = [&](const Image& base, const Image& over){
+                return Resample::resize(over, base.width, base.height, Resample::parseFilter(opt.fit));
+            };
+            auto sized = [&](const Image& base, const Image& over){
+                return fit && (over.width != base.width || over.height != base.height);
+            };
+
+            if(opt.hasFrames){
+                // a non-pattern overlay is loaded (and fitted) once and stays resident
+                const bool overSeq = Sequence::isPattern(argv[3]);
+                Image over, fitted;
+                if(!overSeq) over = ImageIO::load(argv[3]);
+                struct Pair { Image base, over; };
+                forFrames(opt, [&](const Sequence::Range& r){ Sequence::run(r,
+                    [&](int f){
+                        Pair p;
+                        p.base = ImageIO::load(Sequence::format(argv[2], f));
+                        if(overSeq) p.over = ImageIO::load(Sequence::format(argv[3], f));
+                        return p;
+                    },
+                    [&](int, Pair& p){
+                        const Image& o = overSeq ? p.over : over;
+                        if(!sized(p.base, o)) return blendFrame(p.base, o);
+                        if(overSeq) return blendFrame(p.base, fitTo(p.base, o));
+                        if(fitted.width != p.base.width || fitted.height != p.base.height) fitted = fitTo(p.base, o);
+                        return blendFrame(p.base, fitted);
+                    },
+                    [&](int f, const Image& out){ saveFrame(argv[4], f, out); }); });
+                return 0;
+            }
+
             std::cout << "Loading base: "    << argv[2] << "\n";
-            Image base = TGA::load(argv[2]);
+            Image base = ImageIO::load(argv[2]);
             std::cout << "Loading overlay: " << argv[3] << "\n";
-            Image over = TGA::load(argv[3]);
+            Image over = ImageIO::load(argv[3]);
+            if(sized(base, over)){
+                std::cout << "Resizing overlay to " << base.width << "x" << base.height << " (" << opt.fit << ")\n";
+                over = fitTo(base, over);
+            }
             std::cout << "Blending: "        << cmd     << "\n";
-            Image out = Blend::apply(base, over, m);
+            Image out = blendFrame(base, over);
             std::cout << "Saving: "          << argv[4] << "\n";
-            TGA::save(out, argv[4]);
+            ImageIO::save(out, argv[4]);
             return 0;
         }
 
         if(cmd=="addch"){
             if(argc!=6){ usage(argv[0]); return 1; }
-            int idx   = chanIndex(argv[2][0]);
+            ColorSpace::Space sp = ColorSpace::parseSpace(opt.space);
+            int idx   = (sp == ColorSpace::BGR) ? chanIndex(argv[2][0]) : ColorSpace::channelIndex(sp, argv[2]);
             int delta = std::stoi(argv[3]);
-            Image img = TGA::load(argv[4]);
-            addToChannel(img, idx, delta);
-            TGA::save(img, argv[5]);
+            if(opt.hp && (opt.hasRoi || sp != ColorSpace::BGR))
+                throw std::runtime_error(cmd + ": --hp works on whole images in rgb space (drop --roi / --space)");
+            const bool hp = opt.hp;
+            auto adjust = [&](Image& img){
+                ImageView v = opt.hasRoi ? img.view(opt.roi) : img.view();
+                if(sp == ColorSpace::BGR) addToChannel(v, idx, delta);
+                else ColorSpace::addToChannel(v, sp, idx, delta);
+            };
+            if(opt.hasFrames){
+                auto load = [&](int f){ return ImageIO::load(Sequence::format(argv[4], f)); };
+                forFrames(opt, [&](const Sequence::Range& r){
+                    if(hp) Sequence::run(r, load,
+                               [&](int, Image& img){ Image16 hi = HP::promote(img); HP::addToChannel(hi, idx, delta); return hi; },
+                               [&](int f, const Image16& out){ saveFrame(argv[5], f, out); });
+                    else   Sequence::run(r, load,
+                               [&](int, Image& img){ adjust(img); return std::move(img); },
+                               [&](int f, const Image& out){ saveFrame(argv[5], f, out); });
+                });
+                return 0;
+            }
+            Image img = ImageIO::load(argv[4]);
+            if(hp){
+                Image16 hi = HP::promote(img);
+                HP::addToChannel(hi, idx, delta);
+                ImageIO::save(hi, argv[5]);
+                return 0;
+            }
+            adjust(img);
+            ImageIO::save(img, argv[5]);
             return 0;
         }
 
         if(cmd=="scalech"){
             if(argc!=6){ usage(argv[0]); return 1; }
-            int idx   = chanIndex(argv[2][0]);
+            ColorSpace::Space sp = ColorSpace::parseSpace(opt.space);
+            int idx   = (sp == ColorSpace::BGR) ? chanIndex(argv[2][0]) : ColorSpace::channelIndex(sp, argv[2]);
             float f   = std::stof(argv[3]);
-            Image img = TGA::load(argv[4]);
-            scaleChannel(img, idx, f);
-            TGA::save(img, argv[5]);
+            if(opt.hp && (opt.hasRoi || sp != ColorSpace::BGR))
+                throw std::runtime_error(cmd + ": --hp works on whole images in rgb space (drop --roi / --space)");
+            const bool hp = opt.hp;
+            auto adjust = [&](Image& img){
+                ImageView v = opt.hasRoi ? img.view(opt.roi) : img.view();
+                if(sp == ColorSpace::BGR) scaleChannel(v, idx, f);
+                else ColorSpace::scaleChannel(v, sp, idx, f);
+            };
+            if(opt.hasFrames){
+                auto load = [&](int f){ return ImageIO::load(Sequence::format(argv[4], f)); };
+                forFrames(opt, [&](const Sequence::Range& r){
+                    if(hp) Sequence::run(r, load,
+                               [&](int, Image& img){ Image16 hi = HP::promote(img); HP::scaleChannel(hi, idx, f); return hi; },
+                               [&](int f, const Image16& out){ saveFrame(argv[5], f, out); });
+                    else   Sequence::run(r, load,
+                               [&](int, Image& img){ adjust(img); return std::move(img); },
+                               [&](int f, const Image& out){ saveFrame(argv[5], f, out); });
+                });
+                return 0;
+            }
+            Image img = ImageIO::load(argv[4]);
+            if(hp){
+                Image16 hi = HP::promote(img);
+                HP::scaleChannel(hi, idx, f);
+                ImageIO::save(hi, argv[5]);
+                return 0;
+            }
+            adjust(img);
+            ImageIO::save(img, argv[5]);
+            return 0;
+        }
+
+        // trailing N-frame mean, or each frame's difference from the mean of the N before it
+        if(cmd=="tavg" || cmd=="tdiff"){
+            if(argc!=5){ usage(argv[0]); return 1; }
+            if(!opt.hasFrames) throw std::runtime_error(cmd + " needs --frames a-b");
+            int n = std::stoi(argv[2]);
+            if(n < 1) throw std::runtime_error(cmd + ": window must be at least 1 frame");
+            const bool avg = cmd=="tavg";
+            // a shard first replays the n frames before it (without output) to fill its window
+            forFrames(opt, [&](const Sequence::Range& r){
+                Temporal::Window win(n);
+                Sequence::Range warm{std::max(opt.frames.first, r.first - n), r.last};
+                Sequence::run(warm,
+                    [&](int f){ return ImageIO::load(Sequence::format(argv[3], f)); },
+                    [&](int f, Image& img){
+                        Image out = (avg || f < r.first) ? Image() : win.diff(img);
+                        win.push(std::move(img));
+                        return (avg && f >= r.first) ? win.mean() : out;
+                    },
+                    [&](int f, const Image& out){ if(f >= r.first) saveFrame(argv[4], f, out); });
+            });
+            return 0;
+        }
+
+        if(cmd=="gen"){
+            if(argc!=6 && argc!=7){ usage(argv[0]); return 1; }
+            Generate::Kind k = Generate::parse(argv[2]);
+            Generate::Params prm;
+            if(argc==7){
+                if(k == Generate::SOLID)        Canvas::parseColor(argv[6], prm.bgr);
+                else if(k == Generate::CHECKER) prm.cell = std::stoi(argv[6]);
+                else                            prm.seed = static_cast<uint32_t>(std::stoul(argv[6]));
+            }
+            ImageIO::save(Generate::make(k, std::stoi(argv[3]), std::stoi(argv[4]), opt.topLeft, prm), argv[5]);
+            return 0;
+        }
+
+        if(cmd=="shmrm"){
+            if(argc!=3){ usage(argv[0]); return 1; }
+            Shm::remove(argv[2]);
+            return 0;
+        }
+
+        if(cmd=="crop"){
+            if(argc!=8){ usage(argv[0]); return 1; }
+            Image src = ImageIO::load(argv[6]);
+            Rect r{std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), std::stoi(argv[5])};
+            ImageIO::save(copyView(src.view(r)), argv[7]);
+            return 0;
+        }
+
+        if(cmd=="pad"){
+            if(argc!=8 && argc!=9){ usage(argv[0]); return 1; }
+            uint8_t bgr[3] = {0, 0, 0};
+            if(argc==9) Canvas::parseColor(argv[8], bgr);
+            Image src = ImageIO::load(argv[6]);
+            ImageIO::save(Canvas::pad(src, std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), std::stoi(argv[5]), bgr), argv[7]);
+            return 0;
+        }
+
+        if(cmd=="gray"){
+            if(argc!=4){ usage(argv[0]); return 1; }
+            Image src = ImageIO::load(argv[2]);
+            if(ImageIO::hasExt(argv[3], ".tga")) TGA::saveGray(src, argv[3]);
+            else ImageIO::save(ColorSpace::toGray(src), argv[3]);
             return 0;
         }
 
         if(cmd=="split"){
             if(argc!=4){ usage(argv[0]); return 1; }
-            Image src = TGA::load(argv[2]);
+            Image src = ImageIO::load(argv[2]);
             Image r,g,b; splitRGB(src,r,g,b);
-            TGA::save(r, std::string(argv[3]) + "_r.tga");
-            TGA::save(g, std::string(argv[3]) + "_g.tga");
-            TGA::save(b, std::string(argv[3]) + "_b.tga");
+            ImageIO::save(r, std::string(argv[3]) + "_r.tga");
+            ImageIO::save(g, std::string(argv[3]) + "_g.tga");
+            ImageIO::save(b, std::string(argv[3]) + "_b.tga");
             return 0;
         }
 
         if(cmd=="combine"){
             if(argc!=6){ usage(argv[0]); return 1; }
-            Image r = TGA::load(argv[2]);
-            Image g = TGA::load(argv[3]);
-            Image b = TGA::load(argv[4]);
+            Image r = ImageIO::load(argv[2]);
+            Image g = ImageIO::load(argv[3]);
+            Image b = ImageIO::load(argv[4]);
             Image out = combineRGB(r,g,b);
-            TGA::save(out, argv[5]);
+            ImageIO::save(out, argv[5]);
             return 0;
         }
 
         if(cmd=="rot180"){
             if(argc!=4){ usage(argv[0]); return 1; }
-            Image src = TGA::load(argv[2]);
+            Image src = ImageIO::load(argv[2]);
             Image out = rotate180(src);
-            TGA::save(out, argv[3]);
+            ImageIO::save(out, argv[3]);
+            return 0;
+        }
+
+        if(cmd=="resize"){
+            if(argc!=6 && argc!=7){ usage(argv[0]); return 1; }
+            Resample::Filter f = (argc==7) ? Resample::parseFilter(argv[6]) : Resample::LANCZOS3;
+            Image src = ImageIO::load(argv[4]);
+            ImageIO::save(Resample::resize(src, std::stoi(argv[2]), std::stoi(argv[3]), f), argv[5]);
+            return 0;
+        }
+
+        if(cmd=="autolevels"){
+            if(argc!=4 && argc!=5){ usage(argv[0]); return 1; }
+            Image img = ImageIO::load(argv[2]);
+            Levels::autoLevels(img, (argc==5) ? std::stod(argv[4]) / 100.0 : 0.0);
+            ImageIO::save(img, argv[3]);
+            return 0;
+        }
+
+        if(cmd=="equalize"){
+            if(argc!=4){ usage(argv[0]); return 1; }
+            Image img = ImageIO::load(argv[2]);
+            Levels::equalize(img);
+            ImageIO::save(img, argv[3]);
+            return 0;
+        }
+
+        if(cmd=="blur" || cmd=="gblur"){
+            if(argc!=5){ usage(argv[0]); return 1; }
+            Image src = ImageIO::load(argv[3]);
+            Image out = (cmd=="blur") ? Convolve::boxBlur(src, std::stoi(argv[2]))
+                                      : Convolve::gaussianBlur(src, std::stod(argv[2]));
+            ImageIO::save(out, argv[4]);
+            return 0;
+        }
+
+        if(cmd=="sharpen"){
+            if(argc!=6){ usage(argv[0]); return 1; }
+            Image src = ImageIO::load(argv[4]);
+            ImageIO::save(Convolve::unsharp(src, std::stod(argv[2]), std::stod(argv[3])), argv[5]);
+            return 0;
+        }
+
+        if(cmd=="pyramid"){
+            if(argc!=4 && argc!=5){ usage(argv[0]); return 1; }
+            int levels = (argc==5) ? std::stoi(argv[4]) : 16;
+            Image src = ImageIO::load(argv[2]);
+            std::vector<Image> pyr = Pyramid::build(src, levels + 1);
+            for(size_t l=1; l<pyr.size(); ++l)
+                ImageIO::save(pyr[l], ImageIO::withSuffix(argv[3], "_" + std::to_string(l)));
             return 0;
         }
 